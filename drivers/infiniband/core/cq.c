@@ -24,6 +24,11 @@
 #define IB_POLL_FLAGS \
 	(IB_CQ_NEXT_COMP | IB_CQ_REPORT_MISSED_EVENTS)
 
+static bool ib_cq_threaded_poll;
+module_param_named(cq_threaded_poll, ib_cq_threaded_poll, bool, 0644);
+MODULE_PARM_DESC(cq_threaded_poll,
+		 "Poll IB_POLL_SOFTIRQ completion queues from a kernel thread per CQ");
+
 static const struct dim_cq_moder
 rdma_dim_prof[RDMA_DIM_PARAMS_NUM_PROFILES] = {
 	{1,   0, 1,  0},
@@ -253,7 +258,18 @@ struct ib_cq *__ib_alloc_cq(struct ib_device *dev, void *private, int nr_cqe,
 	case IB_POLL_SOFTIRQ:
 		cq->comp_handler = ib_cq_completion_softirq;
 
-		irq_poll_init(&cq->iop, IB_POLL_BUDGET_IRQ, ib_poll_handler);
+		if (ib_cq_threaded_poll) {
+			char name[TASK_COMM_LEN];
+
+			snprintf(name, sizeof(name), "%s-%u",
+				 dev_name(&dev->dev), cq->res.id);
+			/* Falls back to the softirq on failure. */
+			irq_poll_init_threaded(&cq->iop, IB_POLL_BUDGET_IRQ,
+					       ib_poll_handler, name);
+		} else {
+			irq_poll_init(&cq->iop, IB_POLL_BUDGET_IRQ,
+				      ib_poll_handler);
+		}
 		ib_req_notify_cq(cq, IB_CQ_NEXT_COMP);
 		break;
 	case IB_POLL_WORKQUEUE:
@@ -331,6 +347,7 @@ void ib_free_cq(struct ib_cq *cq)
 		break;
 	case IB_POLL_SOFTIRQ:
 		irq_poll_disable(&cq->iop);
+		irq_poll_del(&cq->iop);
 		break;
 	case IB_POLL_WORKQUEUE:
 	case IB_POLL_UNBOUND_WORKQUEUE:
@@ -482,8 +482,9 @@ int ice_setup_rx_ring(struct ice_ring *rx_ring)
 
 	if (rx_ring->vsi->type == ICE_VSI_PF &&
 	    !xdp_rxq_info_is_reg(&rx_ring->xdp_rxq))
-		if (xdp_rxq_info_reg(&rx_ring->xdp_rxq, rx_ring->netdev,
-				     rx_ring->q_index))
+		if (__xdp_rxq_info_reg(&rx_ring->xdp_rxq, rx_ring->netdev,
+				       rx_ring->q_index,
+				       rx_ring->q_vector->napi.napi_id))
 			goto err;
 	return 0;
 
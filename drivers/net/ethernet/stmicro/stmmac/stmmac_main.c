@@ -1622,13 +1622,14 @@ static int alloc_dma_rx_desc_resources(struct stmmac_priv *priv)
 		rx_q->queue_index = queue;
 		rx_q->priv_data = priv;
 
-		pp_params.flags = PP_FLAG_DMA_MAP;
+		pp_params.flags = PP_FLAG_DMA_MAP | PP_FLAG_DMA_SYNC_DEV;
 		pp_params.pool_size = DMA_RX_SIZE;
 		num_pages = DIV_ROUND_UP(priv->dma_buf_sz, PAGE_SIZE);
 		pp_params.order = ilog2(num_pages);
 		pp_params.nid = dev_to_node(priv->device);
 		pp_params.dev = priv->device;
 		pp_params.dma_dir = DMA_FROM_DEVICE;
+		pp_params.max_len = priv->dma_buf_sz;
 
 		rx_q->page_pool = page_pool_create(&pp_params);
 		if (IS_ERR(rx_q->page_pool)) {
@@ -3810,8 +3811,10 @@ static int stmmac_rx(struct stmmac_priv *priv, int limit, u32 queue)
 					buf->page, 0, buf1_len,
 					priv->dma_buf_sz);
 
-			/* Data payload appended into SKB */
-			page_pool_release_page(rx_q->page_pool, buf->page);
+			/* Data payload appended into SKB, page goes back to
+			 * the page_pool when the SKB is freed.
+			 */
+			skb_mark_for_recycle(skb);
 			buf->page = NULL;
 		}
 
@@ -3823,7 +3826,7 @@ static int stmmac_rx(struct stmmac_priv *priv, int limit, u32 queue)
 					priv->dma_buf_sz);
 
 			/* Data payload appended into SKB */
-			page_pool_release_page(rx_q->page_pool, buf->sec_page);
+			skb_mark_for_recycle(skb);
 			buf->sec_page = NULL;
 		}
 
@@ -239,19 +239,83 @@ void wg_packet_send_keepalive(struct wg_peer *peer)
 	wg_packet_send_staged_packets(peer);
 }
 
+/* A UDP GSO train has to fit in a single IP datagram before segmentation,
+ * with 16-bit UDP and IP lengths. The endpoint can change until the train is
+ * sent, so use the IPv4 bound, which also counts the IP header and is the
+ * tighter of the two.
+ */
+#define WG_GSO_MAX_SIZE \
+	(GSO_LEGACY_MAX_SIZE - 1 - sizeof(struct iphdr) - sizeof(struct udphdr))
+
+/* Chains the packets following skb that have the same length, except for a
+ * shorter last one, and the same DS field to its frag_list, so that they go
+ * through the UDP and IP stacks as a single UDP GSO packet. The train is
+ * split again by the device if it supports UDP segmentation offload and
+ * frag_list, or in software right before transmission otherwise. Every
+ * packet already is a complete encrypted message, so each segment carries
+ * exactly one of them. send6() breaks the train up again if the segments
+ * exceed the path MTU. Returns the first packet that wasn't chained.
+ */
+static struct sk_buff *wg_packet_coalesce(struct sk_buff *skb)
+{
+	struct sk_buff *next = skb->next, **tail;
+	unsigned int mss = skb->len, segs = 1;
+
+	if (!next || skb_is_nonlinear(skb))
+		return next;
+
+	tail = &skb_shinfo(skb)->frag_list;
+	while (next && !skb_is_nonlinear(next) && next->len <= mss &&
+	       PACKET_CB(next)->ds == PACKET_CB(skb)->ds &&
+	       skb->len + next->len <= WG_GSO_MAX_SIZE &&
+	       segs < UDP_MAX_SEGMENTS) {
+		struct sk_buff *seg = next;
+
+		next = seg->next;
+		skb_mark_not_on_list(seg);
+		*tail = seg;
+		tail = &seg->next;
+
+		skb->len += seg->len;
+		skb->data_len += seg->len;
+		skb->truesize += seg->truesize;
+		++segs;
+		if (seg->len < mss)
+			break;
+	}
+	if (segs == 1)
+		return next;
+
+	skb_shinfo(skb)->gso_size = mss;
+	skb_shinfo(skb)->gso_type = SKB_GSO_UDP_L4;
+	skb_shinfo(skb)->gso_segs = segs;
+
+	/* udp_tunnel_xmit_skb() only seeds the pseudo-header checksum of GSO
+	 * packets, point the offload at the UDP header it's about to push.
+	 */
+	skb->ip_summed = CHECKSUM_PARTIAL;
+	skb->csum_start = skb_headroom(skb) - sizeof(struct udphdr);
+	skb->csum_offset = offsetof(struct udphdr, check);
+	return next;
+}
+
 static void wg_packet_create_data_done(struct sk_buff *first,
 				       struct wg_peer *peer)
 {
-	struct sk_buff *skb, *next;
+	struct sk_buff *skb = first, *next;
 	bool is_keepalive, data_sent = false;
 
 	wg_timers_any_authenticated_packet_traversal(peer);
 	wg_timers_any_authenticated_packet_sent(peer);
-	skb_list_walk_safe(first, skb, next) {
+	while (skb) {
+		/* Packets chained to a keepalive can only be keepalives too. */
 		is_keepalive = skb->len == message_data_len(0);
+		next = wg_packet_coalesce(skb);
+		skb_mark_not_on_list(skb);
 		if (likely(!wg_socket_send_skb_to_peer(peer, skb,
 				PACKET_CB(skb)->ds) && !is_keepalive))
 			data_sent = true;
+		skb = next;
 	}
 
 	if (likely(data_sent))
@@ -94,6 +94,27 @@ static int send4(struct wg_device *wg, struct sk_buff *skb,
 	return ret;
 }
 
+#if IS_ENABLED(CONFIG_IPV6)
+/* IPv6 doesn't fragment GSO packets locally, so undo wg_packet_coalesce()
+ * when the segments of a train don't fit the path MTU: sent one by one, the
+ * packets are fragmented like before trains existed.
+ */
+static struct sk_buff *wg_packet_uncoalesce(struct sk_buff *skb)
+{
+	struct sk_buff *segs = skb_shinfo(skb)->frag_list, *seg;
+
+	skb_shinfo(skb)->frag_list = NULL;
+	for (seg = segs; seg; seg = seg->next)
+		skb->truesize -= seg->truesize;
+	skb->len -= skb->data_len;
+	skb->data_len = 0;
+	skb_gso_reset(skb);
+	skb->ip_summed = CHECKSUM_NONE;
+	skb->next = segs;
+	return skb;
+}
+#endif
+
 static int send6(struct wg_device *wg, struct sk_buff *skb,
 		 struct endpoint *endpoint, u8 ds, struct dst_cache *cache)
 {
@@ -108,12 +129,11 @@ static int send6(struct wg_device *wg, struct sk_buff *skb,
 		/* TODO: addr->sin6_flowinfo */
 	};
 	struct dst_entry *dst = NULL;
+	struct sk_buff *next;
 	struct sock *sock;
 	int ret = 0;
 
 	skb_mark_not_on_list(skb);
-	skb->dev = wg->dev;
-	skb->mark = wg->fwmark;
 
 	rcu_read_lock_bh();
 	sock = rcu_dereference_bh(wg->sock6);
@@ -148,10 +168,21 @@ static int send6(struct wg_device *wg, struct sk_buff *skb,
 			dst_cache_set_ip6(cache, dst, &fl.saddr);
 	}
 
-	skb->ignore_df = 1;
-	udp_tunnel6_xmit_skb(dst, sock, skb, skb->dev, &fl.saddr, &fl.daddr, ds,
-			     ip6_dst_hoplimit(dst), 0, fl.fl6_sport,
-			     fl.fl6_dport, false);
+	if (skb_is_gso(skb) &&
+	    skb_shinfo(skb)->gso_size + sizeof(struct ipv6hdr) +
+	    sizeof(struct udphdr) > dst_mtu(dst))
+		skb = wg_packet_uncoalesce(skb);
+
+	skb_list_walk_safe(skb, skb, next) {
+		skb_mark_not_on_list(skb);
+		skb->dev = wg->dev;
+		skb->mark = wg->fwmark;
+		skb->ignore_df = 1;
+		udp_tunnel6_xmit_skb(next ? dst_clone(dst) : dst, sock, skb,
+				     skb->dev, &fl.saddr, &fl.daddr, ds,
+				     ip6_dst_hoplimit(dst), 0, fl.fl6_sport,
+				     fl.fl6_dport, false);
+	}
 	goto out;
 
 err:
@@ -314,6 +345,7 @@ void wg_socket_clear_peer_endpoint_src(struct wg_peer *peer)
 
 static int wg_receive(struct sock *sk, struct sk_buff *skb)
 {
+	struct sk_buff *segs, *next;
 	struct wg_device *wg;
 
 	if (unlikely(!sk))
@@ -322,7 +354,22 @@ static int wg_receive(struct sock *sk, struct sk_buff *skb)
 	if (unlikely(!wg))
 		goto err;
 	skb_mark_not_on_list(skb);
-	wg_packet_receive(wg, skb);
+	if (likely(!skb_is_gso(skb))) {
+		wg_packet_receive(wg, skb);
+		return 0;
+	}
+
+	/* A train of messages merged by UDP GRO, which went through the stack
+	 * once. Split it back up and hand the messages over one by one, so that
+	 * decryption still fans out to all CPUs.
+	 */
+	__skb_push(skb, -skb_mac_offset(skb));
+	segs = udp_rcv_segment(sk, skb, sk->sk_family == AF_INET);
+	skb_list_walk_safe(segs, skb, next) {
+		skb_mark_not_on_list(skb);
+		__skb_pull(skb, skb_transport_offset(skb));
+		wg_packet_receive(wg, skb);
+	}
 	return 0;
 
 err:
@@ -343,6 +390,8 @@ static void set_sock_opts(struct socket *sock)
 	sock->sk->sk_allocation = GFP_ATOMIC;
 	sock->sk->sk_sndbuf = INT_MAX;
 	sk_set_memalloc(sock->sk);
+	/* Let UDP GRO merge trains of messages from the same peer. */
+	udp_sk(sock->sk)->gro_enabled = 1;
 }
 
 int wg_socket_init(struct wg_device *wg, u16 port)
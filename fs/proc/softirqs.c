@@ -5,7 +5,8 @@
 #include <linux/seq_file.h>
 
 /*
- * /proc/softirqs  ... display the number of softirqs
+ * /proc/softirqs  ... display the number of softirqs and the time spent
+ * in their handlers in microseconds
  */
 static int show_softirqs(struct seq_file *p, void *v)
 {
@@ -22,6 +23,15 @@ static int show_softirqs(struct seq_file *p, void *v)
 			seq_printf(p, " %10u", kstat_softirqs_cpu(i, j));
 		seq_putc(p, '\n');
 	}
+
+	for (i = 0; i < NR_SOFTIRQS; i++) {
+		seq_printf(p, "%7s_TIME:", softirq_to_name[i]);
+		for_each_possible_cpu(j)
+			seq_printf(p, " %10llu",
+				   div_u64(kstat_softirq_time_cpu(i, j),
+					   NSEC_PER_USEC));
+		seq_putc(p, '\n');
+	}
 	return 0;
 }
 
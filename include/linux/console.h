@@ -23,6 +23,7 @@ struct console_font;
 struct module;
 struct tty_struct;
 struct notifier_block;
+struct task_struct;
 
 enum con_scroll {
 	SM_UP,
@@ -152,6 +153,9 @@ struct console {
 	int	cflag;
 	void	*data;
 	struct	 console *next;
+	u64	seq;		/* next record to print, see printk.c */
+	unsigned long dropped;
+	struct task_struct *thread;
 };
 
 /*
@@ -548,6 +548,13 @@ enum
  */
 extern const char * const softirq_to_name[NR_SOFTIRQS];
 
+/*
+ * Per vector time budget of a softirq run outside of ksoftirqd, in
+ * microseconds. A vector exceeding its budget is deferred to ksoftirqd
+ * until ksoftirqd has drained it, 0 disables the budget.
+ */
+extern int sysctl_softirq_budget_us[NR_SOFTIRQS];
+
 /* softirq mask and active fields moved to irq_cpustat_t in
  * asm/hardirq.h to get better cache usage.  KAO
  */
@@ -10,15 +10,20 @@ struct irq_poll {
 	unsigned long state;
 	int weight;
 	irq_poll_fn *poll;
+	struct task_struct *thread;
 };
 
 enum {
 	IRQ_POLL_F_SCHED	= 0,
 	IRQ_POLL_F_DISABLE	= 1,
+	IRQ_POLL_F_SCHED_THREADED = 2,	/* the poll thread has to run */
 };
 
 extern void irq_poll_sched(struct irq_poll *);
 extern void irq_poll_init(struct irq_poll *, int, irq_poll_fn *);
+extern int irq_poll_init_threaded(struct irq_poll *, int, irq_poll_fn *,
+				  const char *);
+extern void irq_poll_del(struct irq_poll *);
 extern void irq_poll_complete(struct irq_poll *);
 extern void irq_poll_enable(struct irq_poll *);
 extern void irq_poll_disable(struct irq_poll *);
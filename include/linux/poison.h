@@ -37,6 +37,9 @@
 
 #define TAIL_MAPPING	((void *) 0x400 + POISON_POINTER_DELTA)
 
+/********** net/core/page_pool.c **********/
+#define PP_SIGNATURE		(0x40 + POISON_POINTER_DELTA)
+
 /********** mm/slab.c **********/
 /*
  * Magic nums for obj red zoning.
@@ -21,6 +21,8 @@
 #include <net/net_namespace.h>
 
 struct ppp_channel;
+struct net_device_path;
+struct net_device_path_ctx;
 
 struct ppp_channel_ops {
 	/* Send a packet (or multilink fragment) on this channel.
@@ -28,6 +30,11 @@ struct ppp_channel_ops {
 	int	(*start_xmit)(struct ppp_channel *, struct sk_buff *);
 	/* Handle an ioctl call that has come in via /dev/ppp. */
 	int	(*ioctl)(struct ppp_channel *, unsigned int, unsigned long);
+	/* Describe the channel as a hop of a forwarding path, see
+	   dev_fill_forward_path(). */
+	int	(*fill_forward_path)(struct net_device_path_ctx *,
+				     struct net_device_path *,
+				     const struct ppp_channel *);
 };
 
 struct ppp_channel {
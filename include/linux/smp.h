@@ -73,6 +73,17 @@ void on_each_cpu_cond_mask(smp_cond_func_t cond_func, smp_call_func_t func,
 
 int smp_call_function_single_async(int cpu, call_single_data_t *csd);
 
+/*
+ * Batched cross calls: queue functions for sets of processors and send
+ * the IPIs at once. Every processor runs all its queued functions from
+ * a single interrupt.
+ */
+#define SMP_CALL_BATCH_MAX	4
+
+void smp_call_batch_add(const struct cpumask *mask, smp_call_func_t func,
+			void *info);
+void smp_call_batch_kick(bool wait);
+
 #ifdef CONFIG_SMP
 
 #include <linux/preempt.h>
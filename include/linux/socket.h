@@ -360,6 +360,8 @@ struct ucred {
 #define SOL_KCM		281
 #define SOL_TLS		282
 #define SOL_XDP		283
+#define SOL_MPTCP	284
+#define SOL_UNIX	285
 
 /* IPX options */
 #define IPX_TYPE	1
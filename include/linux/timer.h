@@ -52,7 +52,9 @@ struct timer_list {
  *
  * @TIMER_PINNED: A pinned timer will not be affected by any timer
  * placement heuristics (like, NOHZ) and will always expire on the CPU
- * on which the timer was enqueued.
+ * on which the timer was enqueued. Non-pinned timers may be expired by
+ * another CPU while the CPU they were enqueued on is idle. add_timer_on()
+ * sets this flag.
  *
  * Note: Because enqueuing of timers can migrate the timer from one
  * CPU to another, pinned timers are not guaranteed to stay on the
@@ -129,6 +129,22 @@ struct rcu_work {
 	struct workqueue_struct *wq;
 };
 
+/*
+ * Affinity scopes of unbound workqueues.  The CPUs are grouped into pods
+ * according to the scope, and a work item issued on a CPU is served by
+ * the pool_workqueue of that CPU's pod.
+ */
+enum wq_affn_scope {
+	WQ_AFFN_DFL,			/* use system default */
+	WQ_AFFN_CPU,			/* one pod per CPU */
+	WQ_AFFN_SMT,			/* one pod per SMT core */
+	WQ_AFFN_CACHE,			/* one pod per last level cache */
+	WQ_AFFN_NUMA,			/* one pod per NUMA node */
+	WQ_AFFN_SYSTEM,			/* one pod across the whole system */
+
+	WQ_AFFN_NR_TYPES,
+};
+
 /**
  * struct workqueue_attrs - A struct for workqueue attributes.
  *
@@ -146,13 +162,29 @@ struct workqueue_attrs {
 	cpumask_var_t cpumask;
 
 	/**
-	 * @no_numa: disable NUMA affinity
+	 * @pod_cpumask: CPUs of the pod a worker_pool serves
+	 *
+	 * Only meaningful for worker_pools of unbound workqueues.  Workers are
+	 * allowed on @cpumask but are steered back into @pod_cpumask when
+	 * woken up, unless @affn_strict is set in which case @cpumask is
+	 * already restricted to the pod.
+	 */
+	cpumask_var_t pod_cpumask;
+
+	/**
+	 * @affn_strict: keep workers strictly inside their pod
+	 */
+	bool affn_strict;
+
+	/**
+	 * @affn_scope: unbound CPU affinity scope, see &enum wq_affn_scope
 	 *
-	 * Unlike other fields, ``no_numa`` isn't a property of a worker_pool. It
-	 * only modifies how :c:func:`apply_workqueue_attrs` select pools and thus
-	 * doesn't participate in pool hash calculations or equality comparisons.
+	 * Unlike other fields, ``affn_scope`` isn't a property of a
+	 * worker_pool. It only modifies how :c:func:`apply_workqueue_attrs`
+	 * select pools and thus doesn't participate in pool hash calculations
+	 * or equality comparisons.
 	 */
-	bool no_numa;
+	enum wq_affn_scope affn_scope;
 };
 
 static inline struct delayed_work *to_delayed_work(struct work_struct *work)
@@ -667,5 +699,6 @@ int workqueue_offline_cpu(unsigned int cpu);
 
 void __init workqueue_init_early(void);
 void __init workqueue_init(void);
+void __init workqueue_init_topology(void);
 
 #endif
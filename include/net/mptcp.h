@@ -13,6 +13,8 @@
 #include <linux/types.h>
 
 struct seq_file;
+struct mptcp_sock;
+struct mptcp_subflow_context;
 
 /* MPTCP sk_buff extension data */
 struct mptcp_ext {
@@ -57,6 +59,46 @@ struct mptcp_out_options {
 #endif
 };
 
+#define MPTCP_SCHED_NAME_MAX	16
+#define MPTCP_SCHED_MAX_SUBFLOWS	8
+
+/* snapshot of a subflow, as seen by packet schedulers */
+struct mptcp_sched_subflow {
+	struct mptcp_subflow_context *context;
+	u32	srtt_us;	/* smoothed RTT << 3, as tcp_sock */
+	u32	snd_cwnd;
+	u32	packets_out;
+	u32	mss_cache;
+	u64	pacing_rate;	/* bytes per second */
+	u8	backup;
+	u8	memory_free;	/* subflow can queue more data */
+};
+
+struct mptcp_sched_data {
+	struct mptcp_sched_subflow subflows[MPTCP_SCHED_MAX_SUBFLOWS];
+	u8	nr_subflows;
+	bool	reinject;	/* picking a subflow for retransmission */
+	u32	scheduled;	/* set by scheduler: mask of subflows[] to use */
+};
+
+/* Packet scheduler: get_subflow() sets bits in data->scheduled and returns
+ * 0, or an error if no subflow can be used. New data is queued on the
+ * first subflow set in data->scheduled and copied on any other one.
+ * Retransmissions only use the first one.
+ */
+struct mptcp_sched_ops {
+	int (*get_subflow)(struct mptcp_sock *msk,
+			   struct mptcp_sched_data *data);
+
+	/* optional, called on socket creation and release */
+	void (*init)(struct mptcp_sock *msk);
+	void (*release)(struct mptcp_sock *msk);
+
+	char			name[MPTCP_SCHED_NAME_MAX];
+	struct module		*owner;
+	struct list_head	list;
+} ____cacheline_aligned_in_smp;
+
 #ifdef CONFIG_MPTCP
 extern struct request_sock_ops mptcp_subflow_request_sock_ops;
 
@@ -131,6 +173,8 @@ static inline bool mptcp_skb_can_collapse(const struct sk_buff *to,
 }
 
 void mptcp_seq_show(struct seq_file *seq);
+int mptcp_register_scheduler(struct mptcp_sched_ops *sched);
+void mptcp_unregister_scheduler(struct mptcp_sched_ops *sched);
 int mptcp_subflow_init_cookie_req(struct request_sock *req,
 				  const struct sock *sk_listener,
 				  struct sk_buff *skb);
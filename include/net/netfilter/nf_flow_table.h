@@ -4,6 +4,8 @@
 #include <linux/in.h>
 #include <linux/in6.h>
 #include <linux/netdevice.h>
+#include <linux/if_pppox.h>
+#include <linux/ppp_defs.h>
 #include <linux/rhashtable-types.h>
 #include <linux/rcupdate.h>
 #include <linux/netfilter.h>
@@ -89,6 +91,13 @@ enum flow_offload_tuple_dir {
 	FLOW_OFFLOAD_DIR_MAX = IP_CT_DIR_MAX
 };
 
+enum flow_offload_xmit_type {
+	FLOW_OFFLOAD_XMIT_NEIGH		= 0,
+	FLOW_OFFLOAD_XMIT_DIRECT,
+};
+
+#define NF_FLOW_TABLE_ENCAP_MAX		2
+
 struct flow_offload_tuple {
 	union {
 		struct in_addr		src_v4;
@@ -107,11 +116,27 @@ struct flow_offload_tuple {
 
 	u8				l3proto;
 	u8				l4proto;
+	/* VLAN tags and PPPoE session on @iifidx, outermost first */
+	struct {
+		u16			id;
+		__be16			proto;
+	} encap[NF_FLOW_TABLE_ENCAP_MAX];
+
+	/* All members above are keys for lookups, see flow_offload_hash(). */
 	u8				dir;
+	u8				encap_num;
+	u8				xmit_type;
 
 	u16				mtu;
 
 	struct dst_entry		*dst_cache;
+
+	/* Cached layer 2 egress path, for FLOW_OFFLOAD_XMIT_DIRECT */
+	struct {
+		u32			ifidx;
+		u8			h_source[ETH_ALEN];
+		u8			h_dest[ETH_ALEN];
+	} out;
 };
 
 struct flow_offload_tuple_rhash {
@@ -154,7 +179,21 @@ static inline __s32 nf_flow_timeout_delta(unsigned int timeout)
 
 struct nf_flow_route {
 	struct {
-		struct dst_entry	*dst;
+		struct dst_entry		*dst;
+		struct {
+			u32			ifindex;
+			struct {
+				u16		id;
+				__be16		proto;
+			} encap[NF_FLOW_TABLE_ENCAP_MAX];
+			u8			num_encaps;
+		} in;
+		struct {
+			u32			ifindex;
+			u8			h_source[ETH_ALEN];
+			u8			h_dest[ETH_ALEN];
+		} out;
+		enum flow_offload_xmit_type	xmit_type;
 	} tuple[FLOW_OFFLOAD_DIR_MAX];
 };
 
@@ -236,6 +275,26 @@ struct flow_ports {
 	__be16 source, dest;
 };
 
+/* Network protocol carried by a PPPoE session frame, 0 if unsupported */
+static inline __be16 nf_flow_pppoe_proto(struct sk_buff *skb)
+{
+	__be16 proto;
+
+	if (!pskb_may_pull(skb, PPPOE_SES_HLEN))
+		return 0;
+
+	proto = *((__be16 *)(skb_network_header(skb) +
+			     sizeof(struct pppoe_hdr)));
+	switch (proto) {
+	case htons(PPP_IP):
+		return htons(ETH_P_IP);
+	case htons(PPP_IPV6):
+		return htons(ETH_P_IPV6);
+	}
+
+	return 0;
+}
+
 unsigned int nf_flow_offload_ip_hook(void *priv, struct sk_buff *skb,
 				     const struct nf_hook_state *state);
 unsigned int nf_flow_offload_ipv6_hook(void *priv, struct sk_buff *skb,
@@ -271,6 +271,8 @@ struct bpf_sk_storage;
   *	@sk_forward_alloc: space allocated forward
   *	@sk_napi_id: id of the last napi context to receive data for sk
   *	@sk_ll_usec: usecs to busypoll when there is no data
+  *	@sk_prefer_busy_poll: prefer busypolling over softirq processing
+  *	@sk_busy_poll_budget: napi processing budget when busypolling
   *	@sk_allocation: allocation mode
   *	@sk_pacing_rate: Pacing rate (if supported by transport/packet scheduler)
   *	@sk_pacing_status: Pacing status (requested, handled by sch_fq)
@@ -495,6 +497,10 @@ struct sock {
 	u8			sk_txtime_deadline_mode : 1,
 				sk_txtime_report_errors : 1,
 				sk_txtime_unused : 6;
+#ifdef CONFIG_NET_RX_BUSY_POLL
+	u8			sk_prefer_busy_poll;
+	u16			sk_busy_poll_budget;
+#endif
 
 	struct socket		*sk_socket;
 	void			*sk_user_data;
@@ -1189,6 +1195,7 @@ struct proto {
 	void			(*enter_memory_pressure)(struct sock *sk);
 	void			(*leave_memory_pressure)(struct sock *sk);
 	atomic_long_t		*memory_allocated;	/* Current allocated memory. */
+	int __percpu		*per_cpu_fw_alloc;	/* Per cpu reserve, optional */
 	struct percpu_counter	*sockets_allocated;	/* Current number of sockets. */
 	/*
 	 * Pressure flag: try to collapse.
@@ -1324,16 +1331,46 @@ sk_memory_allocated(const struct sock *sk)
 	return atomic_long_read(sk->sk_prot->memory_allocated);
 }
 
-static inline long
+/* Pages a cpu may charge to or release from a protocol that has
+ * per_cpu_fw_alloc before it is folded into memory_allocated.
+ */
+#define SK_MEMORY_PCPU_RESERVE (1 << (20 - PAGE_SHIFT))
+extern int sysctl_mem_pcpu_rsv;
+
+static inline void
 sk_memory_allocated_add(struct sock *sk, int amt)
 {
-	return atomic_long_add_return(amt, sk->sk_prot->memory_allocated);
+	struct proto *prot = sk->sk_prot;
+	int local_reserve;
+
+	if (!prot->per_cpu_fw_alloc) {
+		atomic_long_add(amt, prot->memory_allocated);
+		return;
+	}
+
+	local_reserve = this_cpu_add_return(*prot->per_cpu_fw_alloc, amt);
+	if (local_reserve >= READ_ONCE(sysctl_mem_pcpu_rsv)) {
+		local_reserve = this_cpu_xchg(*prot->per_cpu_fw_alloc, 0);
+		atomic_long_add(local_reserve, prot->memory_allocated);
+	}
 }
 
 static inline void
 sk_memory_allocated_sub(struct sock *sk, int amt)
 {
-	atomic_long_sub(amt, sk->sk_prot->memory_allocated);
+	struct proto *prot = sk->sk_prot;
+	int local_reserve;
+
+	if (!prot->per_cpu_fw_alloc) {
+		atomic_long_sub(amt, prot->memory_allocated);
+		return;
+	}
+
+	local_reserve = this_cpu_sub_return(*prot->per_cpu_fw_alloc, amt);
+	if (local_reserve <= -READ_ONCE(sysctl_mem_pcpu_rsv)) {
+		local_reserve = this_cpu_xchg(*prot->per_cpu_fw_alloc, 0);
+		atomic_long_add(local_reserve, prot->memory_allocated);
+	}
 }
 
 static inline void sk_sockets_allocated_dec(struct sock *sk)
@@ -1361,7 +1398,8 @@ proto_sockets_allocated_sum_positive(struct proto *prot)
 static inline long
 proto_memory_allocated(struct proto *prot)
 {
-	return atomic_long_read(prot->memory_allocated);
+	/* The per cpu reserves can leave the sum transiently negative */
+	return max(0L, atomic_long_read(prot->memory_allocated));
 }
 
 static inline bool
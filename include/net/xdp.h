@@ -59,6 +59,7 @@ struct xdp_rxq_info {
 	u32 queue_index;
 	u32 reg_state;
 	struct xdp_mem_info mem;
+	unsigned int napi_id;
 } ____cacheline_aligned; /* perf critical, avoid false-sharing */
 
 struct xdp_txq_info {
@@ -210,8 +211,18 @@ static inline void xdp_release_frame(struct xdp_frame *xdpf)
 		__xdp_release_frame(xdpf->data, mem);
 }
 
-int xdp_rxq_info_reg(struct xdp_rxq_info *xdp_rxq,
-		     struct net_device *dev, u32 queue_index);
+int __xdp_rxq_info_reg(struct xdp_rxq_info *xdp_rxq,
+		       struct net_device *dev, u32 queue_index,
+		       unsigned int napi_id);
+
+/* Drivers supporting busy polling of AF_XDP sockets pass the NAPI id of
+ * the queue to __xdp_rxq_info_reg().
+ */
+static inline int xdp_rxq_info_reg(struct xdp_rxq_info *xdp_rxq,
+				   struct net_device *dev, u32 queue_index)
+{
+	return __xdp_rxq_info_reg(xdp_rxq, dev, queue_index, 0);
+}
 void xdp_rxq_info_unreg(struct xdp_rxq_info *xdp_rxq);
 void xdp_rxq_info_unused(struct xdp_rxq_info *xdp_rxq);
 bool xdp_rxq_info_is_reg(struct xdp_rxq_info *xdp_rxq);
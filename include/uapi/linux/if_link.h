@@ -171,6 +171,7 @@ enum {
 	IFLA_ALT_IFNAME, /* Alternative ifname */
 	IFLA_PERM_ADDRESS,
 	IFLA_PROTO_DOWN_REASON,
+	IFLA_GRO_MAX_SIZE,
 	__IFLA_MAX
 };
 
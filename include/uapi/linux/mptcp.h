@@ -103,4 +103,7 @@ struct mptcp_info {
 	__u64	mptcpi_rcv_nxt;
 };
 
+/* MPTCP socket options, at SOL_MPTCP level */
+#define MPTCP_SCHEDULER		1	/* packet scheduler name */
+
 #endif /* _UAPI_MPTCP_H */
@@ -349,5 +349,19 @@ struct tcp_zerocopy_receive {
 	__u32 recv_skip_hint;	/* out: amount of bytes to skip */
 	__u32 inq; /* out: amount of bytes in read queue */
 	__s32 err; /* out: socket error */
+	__u64 copybuf_address;	/* in: copybuf address (small reads) */
+	__s32 copybuf_len; /* in/out: copybuf bytes avail/used or error */
+	__u32 flags; /* in: TCP_RECEIVE_ZEROCOPY_FLAG_* */
+	__u64 msg_control; /* ancillary data, not supported: set to 0 */
+	__u64 msg_controllen;
+	__u32 msg_flags;
+	__u32 reserved; /* set to 0 for now */
+	__u32 copybuf_head_len; /* out: copybuf bytes preceding the mapping */
+	__u32 reserved2; /* set to 0 for now */
 };
+
+/* The caller keeps the mapping clean, only zap the range if needed */
+#define TCP_RECEIVE_ZEROCOPY_FLAG_TLB_CLEAN_HINT	0x1
+/* Copy the unaligned data preceding the first mappable page to copybuf */
+#define TCP_RECEIVE_ZEROCOPY_FLAG_COPY_HEAD		0x80000000
 #endif /* _UAPI_LINUX_TCP_H */
@@ -13,4 +13,7 @@ struct sockaddr_un {
 
 #define SIOCUNIXFILE (SIOCPROTOPRIVATE + 0) /* open a socket file with O_PATH */
 
+/* SOL_UNIX control message type of MSG_ERRQUEUE notifications */
+#define UNIX_RECVERR	1
+
 #endif /* _LINUX_UN_H */
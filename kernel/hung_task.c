@@ -186,6 +186,7 @@ static void check_hung_uninterruptible_tasks(unsigned long timeout)
 		return;
 
 	hung_task_show_lock = false;
+	printk_prefer_direct_enter();
 	rcu_read_lock();
 	for_each_process_thread(g, t) {
 		if (!max_count--)
@@ -209,6 +210,8 @@ static void check_hung_uninterruptible_tasks(unsigned long timeout)
 		trigger_all_cpu_backtrace();
 	}
 
+	printk_prefer_direct_exit();
+
 	if (hung_task_call_panic)
 		panic("hung_task: blocked tasks");
 }
@@ -383,6 +383,21 @@ void rcu_segcblist_insert_pend_cbs(struct rcu_segcblist *rsclp,
 	WRITE_ONCE(rsclp->tails[RCU_NEXT_TAIL], rclp->tail);
 }
 
+/*
+ * Move callbacks from the specified rcu_cblist to the end of the
+ * new-callbacks segment of the specified rcu_segcblist, accounting for
+ * them in ->len.  The rcu_cblist is left empty.
+ */
+void rcu_segcblist_splice_pend_cbs(struct rcu_segcblist *rsclp,
+				   struct rcu_cblist *rclp)
+{
+	if (!rclp->head)
+		return; /* Nothing to do. */
+	rcu_segcblist_add_len(rsclp, rclp->len); /* Must precede splice. */
+	rcu_segcblist_insert_pend_cbs(rsclp, rclp);
+	rcu_cblist_init(rclp);
+}
+
 /*
  * Advance the callbacks in the specified rcu_segcblist structure based
  * on the current value passed in for the grace-period counter.
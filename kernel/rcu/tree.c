@@ -2868,6 +2868,58 @@ static void check_cb_ovld(struct rcu_data *rdp)
 	raw_spin_unlock_rcu_node(rnp);
 }
 
+#ifdef CONFIG_RCU_LAZY
+
+/*
+ * Move the specified CPU's lazy callbacks to the end of its ->cblist,
+ * returning true if there were any.  The caller must either be running
+ * on that CPU with interrupts disabled or have ensured that the CPU is
+ * offline.  Offloaded CPUs never have lazy callbacks.
+ */
+static bool rcu_lazy_flush(struct rcu_data *rdp)
+{
+	if (!rdp->lazy_cbs.len)
+		return false;
+	rcu_segcblist_splice_pend_cbs(&rdp->cblist, &rdp->lazy_cbs);
+	return true;
+}
+
+/* Racy count of lazy callbacks, for rcu_barrier() and the shrinker. */
+static long rcu_lazy_n_cbs(struct rcu_data *rdp)
+{
+	return READ_ONCE(rdp->lazy_cbs.len);
+}
+
+/*
+ * Flush the lazy callbacks of a CPU that just went offline and cancel its
+ * lazy timer, which timer migration would otherwise move to another CPU.
+ * Left pending, it would keep call_rcu_lazy() from arming a new one once
+ * the CPU is back, leaving its lazy callbacks unbounded in time.
+ */
+static void rcu_lazy_offline(struct rcu_data *rdp)
+{
+	rcu_lazy_flush(rdp);
+	del_timer(&rdp->lazy_timer);
+}
+
+#else /* #ifdef CONFIG_RCU_LAZY */
+
+static bool rcu_lazy_flush(struct rcu_data *rdp)
+{
+	return false;
+}
+
+static void rcu_lazy_offline(struct rcu_data *rdp)
+{
+}
+
+static long rcu_lazy_n_cbs(struct rcu_data *rdp)
+{
+	return 0;
+}
+
+#endif /* #else #ifdef CONFIG_RCU_LAZY */
+
 /* Helper function for call_rcu() and friends.  */
 static void
 __call_rcu(struct rcu_head *head, rcu_callback_t func)
@@ -2907,6 +2959,8 @@ __call_rcu(struct rcu_head *head, rcu_callback_t func)
 			rcu_segcblist_init(&rdp->cblist);
 	}
 
+	// A non-lazy callback pushes this CPU's lazy callbacks ahead of it.
+	rcu_lazy_flush(rdp);
 	check_cb_ovld(rdp);
 	if (rcu_nocb_try_bypass(rdp, head, &was_alldone, flags))
 		return; // Enqueued onto ->nocb_bypass, so just leave.
@@ -2971,6 +3025,157 @@ void call_rcu(struct rcu_head *head, rcu_callback_t func)
 }
 EXPORT_SYMBOL_GPL(call_rcu);
 
+#ifdef CONFIG_RCU_LAZY
+
+/*
+ * Lazy callbacks wait at most rcu_lazy_jiffies before being handed to
+ * RCU, and at most rcu_lazy_batch of them accumulate on a given CPU.
+ */
+static ulong rcu_lazy_jiffies = 10 * HZ;
+module_param(rcu_lazy_jiffies, ulong, 0644);
+static long rcu_lazy_batch = 10000;
+module_param(rcu_lazy_batch, long, 0644);
+
+/*
+ * The lazy timer is pinned, so it fires on the CPU that armed it, except
+ * when it raced with rcu_lazy_offline() for that CPU, which has then
+ * already dealt with its lazy callbacks.
+ */
+static void rcu_lazy_timer_fn(struct timer_list *t)
+{
+	unsigned long flags;
+	struct rcu_data *rdp = from_timer(rdp, t, lazy_timer);
+
+	local_irq_save(flags);
+	if (rdp == this_cpu_ptr(&rcu_data) && rcu_lazy_flush(rdp))
+		invoke_rcu_core();
+	local_irq_restore(flags);
+}
+
+/**
+ * call_rcu_lazy() - Queue a memory-freeing RCU callback, lazily.
+ * @head: structure to be used for queueing the RCU updates.
+ * @func: actual callback function to be invoked after the grace period
+ *
+ * This is call_rcu() for callbacks whose only job is to free memory.
+ * The callback is parked on a per-CPU list and does not ask for a grace
+ * period until rcutree.rcu_lazy_jiffies have passed, the list grows to
+ * rcutree.rcu_lazy_batch entries, a non-lazy callback is queued on the
+ * same CPU, rcu_barrier() is invoked, or the system runs short of memory.
+ * An otherwise idle system therefore runs far fewer grace periods.
+ *
+ * The memory-ordering guarantees are exactly those of call_rcu(), but
+ * nothing other than rcu_barrier() may wait for the callback to run.
+ */
+void call_rcu_lazy(struct rcu_head *head, rcu_callback_t func)
+{
+	unsigned long flags;
+	struct rcu_data *rdp;
+
+	local_irq_save(flags);
+	rdp = this_cpu_ptr(&rcu_data);
+	if (unlikely(rcu_scheduler_active != RCU_SCHEDULER_RUNNING ||
+		     !rcu_segcblist_is_enabled(&rdp->cblist) ||
+		     rcu_segcblist_is_offloaded(&rdp->cblist))) {
+		local_irq_restore(flags);
+		__call_rcu(head, func);
+		return;
+	}
+
+	/* Misaligned rcu_head! */
+	WARN_ON_ONCE((unsigned long)head & (sizeof(void *) - 1));
+
+	if (debug_rcu_head_queue(head)) {
+		WARN_ONCE(1, "call_rcu_lazy(): Double-freed CB %p->%pS()!!!\n",
+			  head, head->func);
+		WRITE_ONCE(head->func, rcu_leak_callback);
+		local_irq_restore(flags);
+		return;
+	}
+	head->func = func;
+	head->next = NULL;
+	kasan_record_aux_stack(head);
+	rcu_cblist_enqueue(&rdp->lazy_cbs, head);
+
+	if (rdp->lazy_cbs.len >= READ_ONCE(rcu_lazy_batch)) {
+		rcu_lazy_flush(rdp);
+		invoke_rcu_core();
+	} else if (!timer_pending(&rdp->lazy_timer)) {
+		mod_timer(&rdp->lazy_timer,
+			  jiffies + READ_ONCE(rcu_lazy_jiffies));
+	}
+	local_irq_restore(flags);
+}
+EXPORT_SYMBOL_GPL(call_rcu_lazy);
+
+static unsigned long
+rcu_lazy_shrink_count(struct shrinker *shrink, struct shrink_control *sc)
+{
+	int cpu;
+	unsigned long count = 0;
+
+	for_each_online_cpu(cpu)
+		count += rcu_lazy_n_cbs(per_cpu_ptr(&rcu_data, cpu));
+
+	return count;
+}
+
+static bool rcu_lazy_cpu_has_cbs(int cpu, void *unused)
+{
+	return rcu_lazy_n_cbs(per_cpu_ptr(&rcu_data, cpu));
+}
+
+static void rcu_lazy_flush_ipi(void *unused)
+{
+	if (rcu_lazy_flush(this_cpu_ptr(&rcu_data)))
+		invoke_rcu_core();
+}
+
+/*
+ * Under memory pressure, stop being lazy: hand every CPU's lazy callbacks
+ * to RCU so that the memory they free comes back after one grace period.
+ */
+static unsigned long
+rcu_lazy_shrink_scan(struct shrinker *shrink, struct shrink_control *sc)
+{
+	unsigned long count = rcu_lazy_shrink_count(shrink, sc);
+
+	if (!count)
+		return SHRINK_STOP;
+	on_each_cpu_cond(rcu_lazy_cpu_has_cbs, rcu_lazy_flush_ipi, NULL, false);
+
+	return count;
+}
+
+static struct shrinker rcu_lazy_shrinker = {
+	.count_objects = rcu_lazy_shrink_count,
+	.scan_objects = rcu_lazy_shrink_scan,
+	.batch = 0,
+	.seeks = DEFAULT_SEEKS,
+};
+
+static void __init rcu_lazy_init(void)
+{
+	int cpu;
+
+	for_each_possible_cpu(cpu) {
+		struct rcu_data *rdp = per_cpu_ptr(&rcu_data, cpu);
+
+		rcu_cblist_init(&rdp->lazy_cbs);
+		timer_setup(&rdp->lazy_timer, rcu_lazy_timer_fn, TIMER_PINNED);
+	}
+	if (register_shrinker(&rcu_lazy_shrinker))
+		pr_err("Failed to register call_rcu_lazy() shrinker!\n");
+}
+
+#else /* #ifdef CONFIG_RCU_LAZY */
+
+static void __init rcu_lazy_init(void)
+{
+}
+
+#endif /* #else #ifdef CONFIG_RCU_LAZY */
+
 
 /* Maximum number of jiffies to wait before draining a batch. */
 #define KFREE_DRAIN_JIFFIES (HZ / 50)
@@ -3716,6 +3921,7 @@ static void rcu_barrier_func(void *cpu_in)
 	debug_rcu_head_queue(&rdp->barrier_head);
 	rcu_nocb_lock(rdp);
 	WARN_ON_ONCE(!rcu_nocb_flush_bypass(rdp, NULL, jiffies));
+	rcu_lazy_flush(rdp);
 	if (rcu_segcblist_entrain(&rdp->cblist, &rdp->barrier_head)) {
 		atomic_inc(&rcu_state.barrier_cpu_count);
 	} else {
@@ -3779,7 +3985,8 @@ void rcu_barrier(void)
 		if (cpu_is_offline(cpu) &&
 		    !rcu_segcblist_is_offloaded(&rdp->cblist))
 			continue;
-		if (rcu_segcblist_n_cbs(&rdp->cblist) && cpu_online(cpu)) {
+		if ((rcu_segcblist_n_cbs(&rdp->cblist) ||
+		     rcu_lazy_n_cbs(rdp)) && cpu_online(cpu)) {
 			rcu_barrier_trace(TPS("OnlineQ"), cpu,
 					  rcu_state.barrier_sequence);
 			smp_call_function_single(cpu, rcu_barrier_func, (void *)cpu, 1);
@@ -4077,6 +4284,7 @@ void rcutree_migrate_callbacks(int cpu)
 	struct rcu_data *rdp = per_cpu_ptr(&rcu_data, cpu);
 	bool needwake;
 
+	rcu_lazy_offline(rdp); /* Outgoing CPU is dead, so no locking needed. */
 	if (rcu_segcblist_is_offloaded(&rdp->cblist) ||
 	    rcu_segcblist_empty(&rdp->cblist))
 		return;  /* No callbacks to migrate. */
@@ -4430,6 +4638,7 @@ void __init rcu_init(void)
 	rcu_bootup_announce();
 	rcu_init_geometry();
 	rcu_init_one();
+	rcu_lazy_init();
 	if (dump_tree)
 		rcu_dump_rcu_node_tree();
 	if (use_softirq)
@@ -175,6 +175,10 @@ struct rcu_data {
 	unsigned long	n_force_qs_snap;
 					/* did other CPU force QS recently? */
 	long		blimit;		/* Upper limit on a processed batch */
+#ifdef CONFIG_RCU_LAZY
+	struct rcu_cblist lazy_cbs;	/* Lazy CBs not yet in ->cblist. */
+	struct timer_list lazy_timer;	/* Hands ->lazy_cbs to ->cblist. */
+#endif /* #ifdef CONFIG_RCU_LAZY */
 
 	/* 3) dynticks interface. */
 	int dynticks_snap;		/* Per-GP tracking for dynticks. */
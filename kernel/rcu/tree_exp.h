@@ -340,14 +340,19 @@ static void sync_rcu_exp_select_node_cpus(struct work_struct *wp)
 	unsigned long flags;
 	unsigned long mask_ofl_test;
 	unsigned long mask_ofl_ipi;
-	int ret;
+	unsigned long mask_retry;
 	struct rcu_exp_work *rewp =
 		container_of(wp, struct rcu_exp_work, rew_work);
 	struct rcu_node *rnp = container_of(rewp, struct rcu_node, rew);
 
 	raw_spin_lock_irqsave_rcu_node(rnp, flags);
 
-	/* Each pass checks a CPU for identity, offline, and idle. */
+	/*
+	 * Each pass checks a CPU for identity, offline, and idle. The
+	 * dynticks counter is also in an extended quiescent state while
+	 * a nohz_full CPU runs in userspace, so those CPUs are skipped
+	 * here as well, without disturbing them.
+	 */
 	mask_ofl_test = 0;
 	for_each_leaf_node_cpu_mask(rnp, cpu, rnp->expmask) {
 		struct rcu_data *rdp = per_cpu_ptr(&rcu_data, cpu);
@@ -376,40 +381,59 @@ static void sync_rcu_exp_select_node_cpus(struct work_struct *wp)
 		WRITE_ONCE(rnp->exp_tasks, rnp->blkd_tasks.next);
 	raw_spin_unlock_irqrestore_rcu_node(rnp, flags);
 
-	/* IPI the remaining CPUs for expedited quiescent state. */
+	/*
+	 * IPI the remaining CPUs for expedited quiescent state. The CPUs
+	 * are queued into one cross-call batch, so they all get their IPI
+	 * in parallel instead of one after the other.
+	 */
+retry_ipi:
+	mask_retry = 0;
+	preempt_disable();
 	for_each_leaf_node_cpu_mask(rnp, cpu, mask_ofl_ipi) {
 		struct rcu_data *rdp = per_cpu_ptr(&rcu_data, cpu);
 		unsigned long mask = rdp->grpmask;
 
-retry_ipi:
+		/* Recheck, the CPU may have entered idle or userspace since. */
 		if (rcu_dynticks_in_eqs_since(rdp, rdp->exp_dynticks_snap)) {
 			mask_ofl_test |= mask;
 			continue;
 		}
-		if (get_cpu() == cpu) {
-			put_cpu();
+		if (smp_processor_id() == cpu)
+			continue;
+		if (!cpu_online(cpu)) {
+			mask_retry |= mask;
 			continue;
 		}
-		ret = smp_call_function_single(cpu, rcu_exp_handler, NULL, 0);
-		put_cpu();
 		/* The CPU will report the QS in response to the IPI. */
-		if (!ret)
-			continue;
+		smp_call_batch_add(cpumask_of(cpu), rcu_exp_handler, NULL);
+	}
+	smp_call_batch_kick(false);
+	preempt_enable();
 
-		/* Failed, raced with CPU hotplug operation. */
+	/* Failed, raced with CPU hotplug operation. */
+	if (mask_retry) {
 		raw_spin_lock_irqsave_rcu_node(rnp, flags);
-		if ((rnp->qsmaskinitnext & mask) &&
-		    (rnp->expmask & mask)) {
+		for_each_leaf_node_cpu_mask(rnp, cpu, mask_retry) {
+			unsigned long mask = per_cpu_ptr(&rcu_data, cpu)->grpmask;
+
 			/* Online, so delay for a bit and try again. */
-			raw_spin_unlock_irqrestore_rcu_node(rnp, flags);
+			if ((rnp->qsmaskinitnext & mask) &&
+			    (rnp->expmask & mask))
+				continue;
+
+			/* CPU really is offline, so we must report its QS. */
+			if (rnp->expmask & mask)
+				mask_ofl_test |= mask;
+			mask_retry &= ~mask;
+		}
+		raw_spin_unlock_irqrestore_rcu_node(rnp, flags);
+
+		if (mask_retry) {
 			trace_rcu_exp_grace_period(rcu_state.name, rcu_exp_gp_seq_endval(), TPS("selectofl"));
 			schedule_timeout_idle(1);
+			mask_ofl_ipi = mask_retry;
 			goto retry_ipi;
 		}
-		/* CPU really is offline, so we must report its QS. */
-		if (rnp->expmask & mask)
-			mask_ofl_test |= mask;
-		raw_spin_unlock_irqrestore_rcu_node(rnp, flags);
 	}
 	/* Report quiescent states for those that went offline. */
 	if (mask_ofl_test)
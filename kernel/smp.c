@@ -26,10 +26,23 @@
 
 #define CSD_TYPE(_csd)	((_csd)->flags & CSD_FLAG_TYPE_MASK)
 
+/*
+ * The merged payload of a batch for one target CPU. All functions queued
+ * for the target by smp_call_batch_add() run from a single csd.
+ */
+struct cfd_batch {
+	call_single_data_t	csd;
+	unsigned int		nr;
+	smp_call_func_t		func[SMP_CALL_BATCH_MAX];
+	void			*info[SMP_CALL_BATCH_MAX];
+};
+
 struct call_function_data {
 	call_single_data_t	__percpu *csd;
 	cpumask_var_t		cpumask;
 	cpumask_var_t		cpumask_ipi;
+	struct cfd_batch	__percpu *batch;
+	cpumask_var_t		batch_mask;
 };
 
 static DEFINE_PER_CPU_ALIGNED(struct call_function_data, cfd_data);
@@ -50,14 +63,28 @@ int smpcfd_prepare_cpu(unsigned int cpu)
 		free_cpumask_var(cfd->cpumask);
 		return -ENOMEM;
 	}
-	cfd->csd = alloc_percpu(call_single_data_t);
-	if (!cfd->csd) {
+	if (!zalloc_cpumask_var_node(&cfd->batch_mask, GFP_KERNEL,
+				     cpu_to_node(cpu))) {
 		free_cpumask_var(cfd->cpumask);
 		free_cpumask_var(cfd->cpumask_ipi);
 		return -ENOMEM;
 	}
+	cfd->csd = alloc_percpu(call_single_data_t);
+	if (!cfd->csd)
+		goto free_masks;
+	cfd->batch = alloc_percpu(struct cfd_batch);
+	if (!cfd->batch) {
+		free_percpu(cfd->csd);
+		goto free_masks;
+	}
 
 	return 0;
+
+free_masks:
+	free_cpumask_var(cfd->cpumask);
+	free_cpumask_var(cfd->cpumask_ipi);
+	free_cpumask_var(cfd->batch_mask);
+	return -ENOMEM;
 }
 
 int smpcfd_dead_cpu(unsigned int cpu)
@@ -66,7 +93,9 @@ int smpcfd_dead_cpu(unsigned int cpu)
 
 	free_cpumask_var(cfd->cpumask);
 	free_cpumask_var(cfd->cpumask_ipi);
+	free_cpumask_var(cfd->batch_mask);
 	free_percpu(cfd->csd);
+	free_percpu(cfd->batch);
 	return 0;
 }
 
@@ -601,6 +630,137 @@ void smp_call_function(smp_call_func_t func, void *info, int wait)
 }
 EXPORT_SYMBOL(smp_call_function);
 
+static void smp_call_batch_run(void *info)
+{
+	struct cfd_batch *b = info;
+	unsigned int i;
+
+	for (i = 0; i < b->nr; i++)
+		b->func[i](b->info[i]);
+}
+
+/**
+ * smp_call_batch_add(): Queue a function for a set of CPUs.
+ * @mask: The set of cpus to run on (only runs on the online subset),
+ *        which may include the local one.
+ * @func: The function to run. This must be fast and non-blocking.
+ * @info: An arbitrary pointer to pass to the function.
+ *
+ * The functions queued on a CPU are merged into a single payload per
+ * target CPU, which runs from one cross call once smp_call_batch_kick()
+ * sends the IPIs. Queueing the same @func and @info again for a target
+ * is a nop. When a target cannot take another function, the pending
+ * batch is kicked without waiting first.
+ *
+ * Preemption must be disabled from the first smp_call_batch_add() until
+ * smp_call_batch_kick(), and the same rules as for
+ * smp_call_function_many() apply.
+ */
+void smp_call_batch_add(const struct cpumask *mask,
+			smp_call_func_t func, void *info)
+{
+	struct call_function_data *cfd = this_cpu_ptr(&cfd_data);
+	struct cfd_batch *b;
+	unsigned int i;
+	int cpu;
+
+	WARN_ON_ONCE(!in_task() || preemptible());
+
+	for_each_cpu_and(cpu, mask, cfd->batch_mask) {
+		if (per_cpu_ptr(cfd->batch, cpu)->nr == SMP_CALL_BATCH_MAX) {
+			smp_call_batch_kick(false);
+			break;
+		}
+	}
+
+	for_each_cpu_and(cpu, mask, cpu_online_mask) {
+		b = per_cpu_ptr(cfd->batch, cpu);
+
+		if (!cpumask_test_cpu(cpu, cfd->batch_mask)) {
+			/* The previous, unwaited batch may still be running. */
+			csd_lock_wait(&b->csd);
+			b->nr = 0;
+			__cpumask_set_cpu(cpu, cfd->batch_mask);
+		}
+
+		for (i = 0; i < b->nr; i++) {
+			if (b->func[i] == func && b->info[i] == info)
+				break;
+		}
+		if (i < b->nr)
+			continue;
+
+		b->func[b->nr] = func;
+		b->info[b->nr] = info;
+		b->nr++;
+	}
+}
+EXPORT_SYMBOL_GPL(smp_call_batch_add);
+
+/**
+ * smp_call_batch_kick(): Run the queued batch on all of its CPUs.
+ * @wait: If true, wait (atomically) until all queued functions have
+ *        completed on all CPUs.
+ *
+ * Every target CPU gets at most one IPI and drains its whole payload in
+ * that interrupt. Functions queued for the local CPU run here, with
+ * interrupts disabled.
+ */
+void smp_call_batch_kick(bool wait)
+{
+	struct call_function_data *cfd = this_cpu_ptr(&cfd_data);
+	int cpu, this_cpu = smp_processor_id();
+	struct cfd_batch *b;
+
+	if (cpumask_empty(cfd->batch_mask))
+		return;
+
+	WARN_ON_ONCE(cpu_online(this_cpu) && irqs_disabled()
+		     && !oops_in_progress && !early_boot_irqs_disabled);
+	WARN_ON_ONCE(!in_task() || preemptible());
+
+	cpumask_clear(cfd->cpumask_ipi);
+	for_each_cpu(cpu, cfd->batch_mask) {
+		if (cpu == this_cpu)
+			continue;
+
+		b = per_cpu_ptr(cfd->batch, cpu);
+		/*
+		 * The batch csd is always of the SYNC type: the target
+		 * unlocks it only after the payload ran, which keeps the
+		 * payload stable even when the sender does not wait.
+		 */
+		csd_lock(&b->csd);
+		b->csd.flags |= CSD_TYPE_SYNC;
+		b->csd.func = smp_call_batch_run;
+		b->csd.info = b;
+		if (llist_add(&b->csd.llist, &per_cpu(call_single_queue, cpu)))
+			__cpumask_set_cpu(cpu, cfd->cpumask_ipi);
+	}
+
+	/* Send a message to all CPUs in the map */
+	arch_send_call_function_ipi_mask(cfd->cpumask_ipi);
+
+	if (cpumask_test_cpu(this_cpu, cfd->batch_mask)) {
+		unsigned long flags;
+
+		local_irq_save(flags);
+		smp_call_batch_run(per_cpu_ptr(cfd->batch, this_cpu));
+		local_irq_restore(flags);
+	}
+
+	if (wait) {
+		for_each_cpu(cpu, cfd->batch_mask) {
+			if (cpu == this_cpu)
+				continue;
+			csd_lock_wait(&per_cpu_ptr(cfd->batch, cpu)->csd);
+		}
+	}
+
+	cpumask_clear(cfd->batch_mask);
+}
+EXPORT_SYMBOL_GPL(smp_call_batch_kick);
+
 /* Setup configured maximum number of CPUs to activate */
 unsigned int setup_max_cpus = NR_CPUS;
 EXPORT_SYMBOL(setup_max_cpus);
@@ -25,6 +25,7 @@
 #include <linux/smpboot.h>
 #include <linux/tick.h>
 #include <linux/irq.h>
+#include <linux/sched/clock.h>
 
 #define CREATE_TRACE_POINTS
 #include <trace/events/irq.h>
@@ -61,6 +62,21 @@ const char * const softirq_to_name[NR_SOFTIRQS] = {
 	"TASKLET", "SCHED", "HRTIMER", "RCU"
 };
 
+int sysctl_softirq_budget_us[NR_SOFTIRQS] __read_mostly;
+
+/**
+ * struct softirq_budget - per CPU softirq budget accounting
+ * @used:	time spent per vector in the current __do_softirq() run
+ * @deferred:	vectors which exceeded their budget and are left to
+ *		ksoftirqd until it has drained them
+ */
+struct softirq_budget {
+	u64	used[NR_SOFTIRQS];
+	u32	deferred;
+};
+
+static DEFINE_PER_CPU(struct softirq_budget, softirq_budget);
+
 /*
  * we cannot loop indefinitely here to avoid userspace starvation,
  * but we also don't want to introduce a worst case 1/HZ latency
@@ -85,9 +101,16 @@ static void wakeup_softirqd(void)
 static bool ksoftirqd_running(unsigned long pending)
 {
 	struct task_struct *tsk = __this_cpu_read(ksoftirqd);
+	u32 deferred = __this_cpu_read(softirq_budget.deferred);
 
 	if (pending & SOFTIRQ_NOW_MASK)
 		return false;
+	/*
+	 * ksoftirqd was woken for vectors over their budget, the others
+	 * keep running inline.
+	 */
+	if (deferred && (pending & ~deferred))
+		return false;
 	return tsk && (tsk->state == TASK_RUNNING) &&
 		!__kthread_should_park(tsk);
 }
@@ -219,6 +242,23 @@ EXPORT_SYMBOL(__local_bh_enable_ip);
 #define MAX_SOFTIRQ_TIME  msecs_to_jiffies(2)
 #define MAX_SOFTIRQ_RESTART 10
 
+/*
+ * Charge @delta nanoseconds to @vec_nr and defer it to ksoftirqd once it
+ * exceeded its budget in this run.
+ */
+static void softirq_budget_charge(struct softirq_budget *sb,
+				  unsigned int vec_nr, u64 delta)
+{
+	int budget = READ_ONCE(sysctl_softirq_budget_us[vec_nr]);
+
+	if (!budget)
+		return;
+
+	sb->used[vec_nr] += delta;
+	if (sb->used[vec_nr] > (u64)budget * NSEC_PER_USEC)
+		sb->deferred |= BIT(vec_nr);
+}
+
 #ifdef CONFIG_TRACE_IRQFLAGS
 /*
  * When we run softirqs from irq_exit() and thus on the hardirq stack we need
@@ -257,9 +297,11 @@ asmlinkage __visible void __softirq_entry __do_softirq(void)
 	unsigned long end = jiffies + MAX_SOFTIRQ_TIME;
 	unsigned long old_flags = current->flags;
 	int max_restart = MAX_SOFTIRQ_RESTART;
+	struct softirq_budget *sb = this_cpu_ptr(&softirq_budget);
+	bool in_ksoftirqd = __this_cpu_read(ksoftirqd) == current;
 	struct softirq_action *h;
 	bool in_hardirq;
-	__u32 pending;
+	__u32 pending, deferred;
 	int softirq_bit;
 
 	/*
@@ -275,9 +317,17 @@ asmlinkage __visible void __softirq_entry __do_softirq(void)
 	__local_bh_disable_ip(_RET_IP_, SOFTIRQ_OFFSET);
 	in_hardirq = lockdep_softirq_start();
 
+	if (!in_ksoftirqd)
+		memset(sb->used, 0, sizeof(sb->used));
+
 restart:
-	/* Reset the pending bitmask before enabling irqs */
-	set_softirq_pending(0);
+	/*
+	 * Reset the pending bitmask before enabling irqs, vectors over their
+	 * budget stay pending for ksoftirqd.
+	 */
+	deferred = in_ksoftirqd ? 0 : sb->deferred;
+	set_softirq_pending(pending & deferred);
+	pending &= ~deferred;
 
 	local_irq_enable();
 
@@ -286,6 +336,7 @@ asmlinkage __visible void __softirq_entry __do_softirq(void)
 	while ((softirq_bit = ffs(pending))) {
 		unsigned int vec_nr;
 		int prev_count;
+		u64 start, delta;
 
 		h += softirq_bit - 1;
 
@@ -295,8 +346,14 @@ asmlinkage __visible void __softirq_entry __do_softirq(void)
 		kstat_incr_softirqs_this_cpu(vec_nr);
 
 		trace_softirq_entry(vec_nr);
+		start = local_clock();
 		h->action(h);
+		delta = local_clock() - start;
 		trace_softirq_exit(vec_nr);
+
+		kstat_add_softirq_time_this_cpu(vec_nr, delta);
+		if (!in_ksoftirqd)
+			softirq_budget_charge(sb, vec_nr, delta);
 		if (unlikely(prev_count != preempt_count())) {
 			pr_err("huh, entered softirq %u %s %p with preempt_count %08x, exited with %08x?\n",
 			       vec_nr, softirq_to_name[vec_nr], h->action,
@@ -307,14 +364,22 @@ asmlinkage __visible void __softirq_entry __do_softirq(void)
 		pending >>= softirq_bit;
 	}
 
-	if (__this_cpu_read(ksoftirqd) == current)
+	if (in_ksoftirqd)
 		rcu_softirq_qs();
 	local_irq_disable();
 
 	pending = local_softirq_pending();
+	if (in_ksoftirqd) {
+		/* Drained vectors run inline again */
+		sb->deferred &= pending;
+		deferred = 0;
+	} else {
+		deferred = sb->deferred;
+	}
+
 	if (pending) {
-		if (time_before(jiffies, end) && !need_resched() &&
-		    --max_restart)
+		if ((pending & ~deferred) && time_before(jiffies, end) &&
+		    !need_resched() && --max_restart)
 			goto restart;
 
 		wakeup_softirqd();
@@ -70,6 +70,7 @@
 #include <linux/userfaultfd_k.h>
 #include <linux/coredump.h>
 #include <linux/latencytop.h>
+#include <linux/interrupt.h>
 #include <linux/pid.h>
 
 #include "../lib/kstrtox.h"
@@ -2189,6 +2190,14 @@ static struct ctl_table kern_table[] = {
 		.extra1		= &pid_max_min,
 		.extra2		= &pid_max_max,
 	},
+	{
+		.procname	= "softirq_budget_us",
+		.data		= &sysctl_softirq_budget_us,
+		.maxlen		= sizeof(sysctl_softirq_budget_us),
+		.mode		= 0644,
+		.proc_handler	= proc_dointvec_minmax,
+		.extra1		= SYSCTL_ZERO,
+	},
 	{
 		.procname	= "panic_on_oops",
 		.data		= &panic_on_oops,
@@ -165,3 +165,7 @@ DECLARE_PER_CPU(struct hrtimer_cpu_base, hrtimer_bases);
 
 extern u64 get_next_timer_interrupt(unsigned long basej, u64 basem);
 void timer_clear_idle(void);
+#ifdef CONFIG_TIMER_PULL_MIGRATION
+extern void timer_expire_remote(unsigned int cpu);
+extern u64 timer_global_next_expiry(unsigned int cpu);
+#endif
@@ -52,6 +52,7 @@
 #include <asm/io.h>
 
 #include "tick-internal.h"
+#include "timer_migration.h"
 
 #define CREATE_TRACE_POINTS
 #include <trace/events/timer.h>
@@ -180,18 +181,22 @@ EXPORT_SYMBOL(jiffies_64);
 #define WHEEL_TIMEOUT_MAX	(WHEEL_TIMEOUT_CUTOFF - LVL_GRAN(LVL_DEPTH - 1))
 
 /*
- * The resulting wheel size. If NOHZ is configured we allocate two
- * wheels so we have a separate storage for the deferrable timers.
+ * The resulting wheel size. If NOHZ is configured we allocate three
+ * wheels: pinned timers which must expire on this CPU, global timers
+ * which may be expired by another CPU while this one is idle, and the
+ * deferrable timers.
  */
 #define WHEEL_SIZE	(LVL_SIZE * LVL_DEPTH)
 
 #ifdef CONFIG_NO_HZ_COMMON
-# define NR_BASES	2
-# define BASE_STD	0
-# define BASE_DEF	1
+# define NR_BASES	3
+# define BASE_LOCAL	0
+# define BASE_GLOBAL	1
+# define BASE_DEF	2
 #else
 # define NR_BASES	1
-# define BASE_STD	0
+# define BASE_LOCAL	0
+# define BASE_GLOBAL	0
 # define BASE_DEF	0
 #endif
 
@@ -560,6 +565,17 @@ trigger_dyntick_cpu(struct timer_base *base, struct timer_list *timer)
 		return;
 	}
 
+	/*
+	 * A global timer which is rearmed from its own callback while the
+	 * idle owner's base is expired remotely stays on that base. The
+	 * CPU doing the remote expiry hands the new first expiry to the
+	 * timer migration hierarchy afterwards, so there is no point in
+	 * waking the owner.
+	 */
+	if (tmigr_enabled() && base->running_timer == timer &&
+	    !(timer->flags & TIMER_PINNED))
+		return;
+
 	/*
 	 * We might have to IPI the remote CPU if the base is idle and the
 	 * timer is not deferrable. If the other CPU is on the way to idle
@@ -848,30 +864,27 @@ static int detach_if_pending(struct timer_list *timer, struct timer_base *base,
 	return 1;
 }
 
-static inline struct timer_base *get_timer_cpu_base(u32 tflags, u32 cpu)
+static inline unsigned int timer_base_index(u32 tflags)
 {
-	struct timer_base *base = per_cpu_ptr(&timer_bases[BASE_STD], cpu);
-
 	/*
 	 * If the timer is deferrable and NO_HZ_COMMON is set then we need
-	 * to use the deferrable base.
+	 * to use the deferrable base. Otherwise pinned timers go to the
+	 * local base and all others to the global base, which the timer
+	 * migration hierarchy may expire on behalf of an idle CPU.
 	 */
 	if (IS_ENABLED(CONFIG_NO_HZ_COMMON) && (tflags & TIMER_DEFERRABLE))
-		base = per_cpu_ptr(&timer_bases[BASE_DEF], cpu);
-	return base;
+		return BASE_DEF;
+	return tflags & TIMER_PINNED ? BASE_LOCAL : BASE_GLOBAL;
 }
 
-static inline struct timer_base *get_timer_this_cpu_base(u32 tflags)
+static inline struct timer_base *get_timer_cpu_base(u32 tflags, u32 cpu)
 {
-	struct timer_base *base = this_cpu_ptr(&timer_bases[BASE_STD]);
+	return per_cpu_ptr(&timer_bases[timer_base_index(tflags)], cpu);
+}
 
-	/*
-	 * If the timer is deferrable and NO_HZ_COMMON is set then we need
-	 * to use the deferrable base.
-	 */
-	if (IS_ENABLED(CONFIG_NO_HZ_COMMON) && (tflags & TIMER_DEFERRABLE))
-		base = this_cpu_ptr(&timer_bases[BASE_DEF]);
-	return base;
+static inline struct timer_base *get_timer_this_cpu_base(u32 tflags)
+{
+	return this_cpu_ptr(&timer_bases[timer_base_index(tflags)]);
 }
 
 static inline struct timer_base *get_timer_base(u32 tflags)
@@ -883,8 +896,13 @@ static inline struct timer_base *
 get_target_base(struct timer_base *base, unsigned tflags)
 {
 #if defined(CONFIG_SMP) && defined(CONFIG_NO_HZ_COMMON)
+	/*
+	 * With the pull model global timers are always queued locally and
+	 * handed over to the timer migration hierarchy when this CPU goes
+	 * idle, instead of being pushed to a busy CPU at enqueue time.
+	 */
 	if (static_branch_likely(&timers_migration_enabled) &&
-	    !(tflags & TIMER_PINNED))
+	    !tmigr_enabled() && !(tflags & TIMER_PINNED))
 		return get_timer_cpu_base(tflags, get_nohz_timer_target());
 #endif
 	return get_timer_this_cpu_base(tflags);
@@ -1160,6 +1178,9 @@ void add_timer_on(struct timer_list *timer, int cpu)
 
 	BUG_ON(timer_pending(timer) || !timer->function);
 
+	/* The timer must expire on @cpu, keep it out of the global base. */
+	timer->flags |= TIMER_PINNED;
+
 	new_base = get_timer_cpu_base(timer->flags, cpu);
 
 	/*
@@ -1266,8 +1287,10 @@ static inline void timer_base_unlock_expiry(struct timer_base *base)
 static void timer_sync_wait_running(struct timer_base *base)
 {
 	if (atomic_read(&base->timer_waiters)) {
+		raw_spin_unlock_irq(&base->lock);
 		spin_unlock(&base->expiry_lock);
 		spin_lock(&base->expiry_lock);
+		raw_spin_lock_irq(&base->lock);
 	}
 }
 
@@ -1451,14 +1474,14 @@ static void expire_timers(struct timer_base *base, struct hlist_head *head)
 		if (timer->flags & TIMER_IRQSAFE) {
 			raw_spin_unlock(&base->lock);
 			call_timer_fn(timer, fn, baseclk);
-			base->running_timer = NULL;
 			raw_spin_lock(&base->lock);
+			base->running_timer = NULL;
 		} else {
 			raw_spin_unlock_irq(&base->lock);
 			call_timer_fn(timer, fn, baseclk);
+			raw_spin_lock_irq(&base->lock);
 			base->running_timer = NULL;
 			timer_sync_wait_running(base);
-			raw_spin_lock_irq(&base->lock);
 		}
 	}
 }
@@ -1616,6 +1639,54 @@ static u64 cmp_next_hrtimer_event(u64 basem, u64 expires)
 	return DIV_ROUND_UP_ULL(nextevt, TICK_NSEC) * TICK_NSEC;
 }
 
+/*
+ * Widen a jiffies value close to the current time to 64 bit, which is
+ * the time base of the timer migration hierarchy.
+ */
+static inline u64 timer_jiffies64(unsigned long j)
+{
+	u64 now = get_jiffies_64();
+
+	return now + (long)(j - (unsigned long)now);
+}
+
+/*
+ * Store the first expiry of @base in @nextevt and forward the base clock.
+ * Returns false if no timer is pending. Called with @base->lock held.
+ */
+static bool timer_base_next_expiry(struct timer_base *base, unsigned long basej,
+				   unsigned long *nextevt)
+{
+	bool is_max_delta;
+
+	if (base->next_expiry_recalc)
+		base->next_expiry = __next_timer_interrupt(base);
+	*nextevt = base->next_expiry;
+	is_max_delta = (*nextevt == base->clk + NEXT_TIMER_MAX_DELTA);
+
+	/*
+	 * We have a fresh next event. Check whether we can forward the
+	 * base. We can only do that when @basej is past base->clk
+	 * otherwise we might rewind base->clk.
+	 */
+	if (time_after(basej, base->clk)) {
+		if (time_after(*nextevt, basej))
+			base->clk = basej;
+		else if (time_after(*nextevt, base->clk))
+			base->clk = *nextevt;
+	}
+
+	return !is_max_delta;
+}
+
+static u64 timer_jiffies_to_ns(unsigned long nextevt, unsigned long basej,
+			       u64 basem)
+{
+	if (time_before_eq(nextevt, basej))
+		return basem;
+	return basem + (u64)(nextevt - basej) * TICK_NSEC;
+}
+
 /**
  * get_next_timer_interrupt - return the time (clock mono) of the next timer
  * @basej:	base time jiffies
@@ -1623,13 +1694,19 @@ static u64 cmp_next_hrtimer_event(u64 basem, u64 expires)
  *
  * Returns the tick aligned clock monotonic time of the next pending
  * timer or KTIME_MAX if no timer is pending.
+ *
+ * If the CPU is about to go idle and the timer migration hierarchy is
+ * enabled, the global timers are handed over to the hierarchy and only
+ * the pinned timers and the events this CPU has to handle on behalf of
+ * the hierarchy are taken into account.
  */
 u64 get_next_timer_interrupt(unsigned long basej, u64 basem)
 {
-	struct timer_base *base = this_cpu_ptr(&timer_bases[BASE_STD]);
-	u64 expires = KTIME_MAX;
-	unsigned long nextevt;
-	bool is_max_delta;
+	struct timer_base *base_local = this_cpu_ptr(&timer_bases[BASE_LOCAL]);
+	struct timer_base *base_global = this_cpu_ptr(&timer_bases[BASE_GLOBAL]);
+	unsigned long nextevt_local, nextevt_global, nextevt;
+	bool local_pending, global_pending, idle = false;
+	u64 expires = KTIME_MAX, tevt;
 
 	/*
 	 * Pretend that there is no timer pending if the cpu is offline.
@@ -1638,41 +1715,47 @@ u64 get_next_timer_interrupt(unsigned long basej, u64 basem)
 	if (cpu_is_offline(smp_processor_id()))
 		return expires;
 
-	raw_spin_lock(&base->lock);
-	if (base->next_expiry_recalc)
-		base->next_expiry = __next_timer_interrupt(base);
-	nextevt = base->next_expiry;
-	is_max_delta = (nextevt == base->clk + NEXT_TIMER_MAX_DELTA);
+	raw_spin_lock(&base_local->lock);
+	raw_spin_lock_nested(&base_global->lock, SINGLE_DEPTH_NESTING);
 
-	/*
-	 * We have a fresh next event. Check whether we can forward the
-	 * base. We can only do that when @basej is past base->clk
-	 * otherwise we might rewind base->clk.
-	 */
-	if (time_after(basej, base->clk)) {
-		if (time_after(nextevt, basej))
-			base->clk = basej;
-		else if (time_after(nextevt, base->clk))
-			base->clk = nextevt;
+	local_pending = timer_base_next_expiry(base_local, basej, &nextevt_local);
+	global_pending = timer_base_next_expiry(base_global, basej, &nextevt_global);
+
+	if (local_pending || global_pending) {
+		nextevt = nextevt_local;
+		if (!local_pending || (global_pending &&
+				       time_before(nextevt_global, nextevt_local)))
+			nextevt = nextevt_global;
+		expires = timer_jiffies_to_ns(nextevt, basej, basem);
 	}
 
-	if (time_before_eq(nextevt, basej)) {
-		expires = basem;
-		base->is_idle = false;
-	} else {
-		if (!is_max_delta)
-			expires = basem + (u64)(nextevt - basej) * TICK_NSEC;
-		/*
-		 * If we expect to sleep more than a tick, mark the base idle.
-		 * Also the tick is stopped so any added timer must forward
-		 * the base clk itself to keep granularity small. This idle
-		 * logic is only maintained for the BASE_STD base, deferrable
-		 * timers may still see large granularity skew (by design).
-		 */
-		if ((expires - basem) > TICK_NSEC)
-			base->is_idle = true;
+	/*
+	 * If we expect to sleep more than a tick, mark the bases idle.
+	 * Also the tick is stopped so any added timer must forward the
+	 * base clk itself to keep granularity small. This idle logic is
+	 * only maintained for the local and global bases, deferrable
+	 * timers may still see large granularity skew (by design).
+	 */
+	if ((expires - basem) > TICK_NSEC)
+		idle = true;
+	base_local->is_idle = idle;
+	base_global->is_idle = idle;
+
+	raw_spin_unlock(&base_global->lock);
+	raw_spin_unlock(&base_local->lock);
+
+	if (idle && tmigr_enabled()) {
+		tevt = tmigr_cpu_deactivate(global_pending ?
+					    timer_jiffies64(nextevt_global) :
+					    KTIME_MAX);
+
+		expires = KTIME_MAX;
+		if (local_pending)
+			expires = timer_jiffies_to_ns(nextevt_local, basej, basem);
+		if (tevt != KTIME_MAX)
+			expires = min(expires, timer_jiffies_to_ns((unsigned long)tevt,
+								   basej, basem));
 	}
-	raw_spin_unlock(&base->lock);
 
 	return cmp_next_hrtimer_event(basem, expires);
 }
@@ -1684,17 +1767,54 @@ u64 get_next_timer_interrupt(unsigned long basej, u64 basem)
  */
 void timer_clear_idle(void)
 {
-	struct timer_base *base = this_cpu_ptr(&timer_bases[BASE_STD]);
-
 	/*
 	 * We do this unlocked. The worst outcome is a remote enqueue sending
 	 * a pointless IPI, but taking the lock would just make the window for
 	 * sending the IPI a few instructions smaller for the cost of taking
 	 * the lock in the exit from idle path.
 	 */
-	base->is_idle = false;
+	__this_cpu_write(timer_bases[BASE_LOCAL].is_idle, false);
+	__this_cpu_write(timer_bases[BASE_GLOBAL].is_idle, false);
+
+	/* Take the global timers back from the timer migration hierarchy */
+	if (tmigr_enabled())
+		tmigr_cpu_activate();
+}
+
+#ifdef CONFIG_TIMER_PULL_MIGRATION
+/**
+ * timer_expire_remote - expire the global timers of an idle CPU
+ * @cpu:	the idle CPU
+ *
+ * Called from the timer migration hierarchy on the CPU which handles the
+ * events of @cpu while it is idle.
+ */
+void timer_expire_remote(unsigned int cpu)
+{
+	__run_timers(per_cpu_ptr(&timer_bases[BASE_GLOBAL], cpu));
+}
+
+/**
+ * timer_global_next_expiry - first expiry of the global timers of a CPU
+ * @cpu:	the CPU to look at
+ *
+ * Returns the first expiry in 64 bit jiffies or KTIME_MAX if no global
+ * timer is pending on @cpu.
+ */
+u64 timer_global_next_expiry(unsigned int cpu)
+{
+	struct timer_base *base = per_cpu_ptr(&timer_bases[BASE_GLOBAL], cpu);
+	unsigned long nextevt, flags;
+	bool pending;
+
+	raw_spin_lock_irqsave(&base->lock, flags);
+	pending = timer_base_next_expiry(base, jiffies, &nextevt);
+	raw_spin_unlock_irqrestore(&base->lock, flags);
+
+	return pending ? timer_jiffies64(nextevt) : KTIME_MAX;
 }
 #endif
+#endif
 
 /*
  * Called from the timer interrupt handler to charge one tick to the current
@@ -1726,12 +1846,20 @@ static inline void __run_timers(struct timer_base *base)
 	struct hlist_head heads[LVL_DEPTH];
 	int levels;
 
-	if (time_before(jiffies, base->next_expiry))
+	if (time_before(jiffies, READ_ONCE(base->next_expiry)))
 		return;
 
 	timer_base_lock_expiry(base);
 	raw_spin_lock_irq(&base->lock);
 
+	/*
+	 * The global base of an idle CPU may be expired remotely by the
+	 * timer migration hierarchy. Whoever came first expires all due
+	 * timers of the base.
+	 */
+	if (base->running_timer)
+		goto out;
+
 	while (time_after_eq(jiffies, base->clk) &&
 	       time_after_eq(jiffies, base->next_expiry)) {
 		levels = collect_expired_timers(base, heads);
@@ -1747,6 +1875,7 @@ static inline void __run_timers(struct timer_base *base)
 		while (levels--)
 			expire_timers(base, heads + levels);
 	}
+out:
 	raw_spin_unlock_irq(&base->lock);
 	timer_base_unlock_expiry(base);
 }
@@ -1756,11 +1885,16 @@ static inline void __run_timers(struct timer_base *base)
  */
 static __latent_entropy void run_timer_softirq(struct softirq_action *h)
 {
-	struct timer_base *base = this_cpu_ptr(&timer_bases[BASE_STD]);
+	struct timer_base *base = this_cpu_ptr(&timer_bases[BASE_LOCAL]);
 
 	__run_timers(base);
-	if (IS_ENABLED(CONFIG_NO_HZ_COMMON))
+	if (IS_ENABLED(CONFIG_NO_HZ_COMMON)) {
+		__run_timers(this_cpu_ptr(&timer_bases[BASE_GLOBAL]));
 		__run_timers(this_cpu_ptr(&timer_bases[BASE_DEF]));
+
+		if (tmigr_enabled())
+			tmigr_handle_remote();
+	}
 }
 
 /*
@@ -1768,18 +1902,20 @@ static __latent_entropy void run_timer_softirq(struct softirq_action *h)
  */
 void run_local_timers(void)
 {
-	struct timer_base *base = this_cpu_ptr(&timer_bases[BASE_STD]);
+	struct timer_base *base = this_cpu_ptr(&timer_bases[BASE_LOCAL]);
+	int i;
 
 	hrtimer_run_queues();
+
 	/* Raise the softirq only if required. */
-	if (time_before(jiffies, base->next_expiry)) {
-		if (!IS_ENABLED(CONFIG_NO_HZ_COMMON))
-			return;
-		/* CPU is awake, so check the deferrable base. */
-		base++;
-		if (time_before(jiffies, base->next_expiry))
-			return;
+	for (i = 0; i < NR_BASES; i++, base++) {
+		/* CPU is awake, so check all bases including the deferrable one */
+		if (time_after_eq(jiffies, READ_ONCE(base->next_expiry)))
+			goto raise;
 	}
+	if (!tmigr_enabled() || !tmigr_requires_handle_remote())
+		return;
+raise:
 	raise_softirq(TIMER_SOFTIRQ);
 }
 
@@ -0,0 +1,549 @@
+// SPDX-License-Identifier: GPL-2.0
+/*
+ * Pull model timer migration
+ *
+ * Non-pinned timers are queued on the global timer base of the CPU which
+ * enqueues them. When a CPU goes idle it does not push them anywhere but
+ * hands the first expiry of its global timers to a hierarchy of groups,
+ * and one active CPU of each group (the migrator) expires them on behalf
+ * of its idle siblings from the timer softirq. When all children of a
+ * group are idle, the first event of the group is handed to the parent
+ * group in the same way. When the whole hierarchy is idle, the CPU which
+ * last updated the root wakes up for the first event of the root and
+ * handles it.
+ *
+ * The groups follow the cache and NUMA topology so that timers are
+ * expired close to the CPU which queued them: CPUs sharing the last
+ * level cache form a group, the cache groups of a node form a node group
+ * and all node groups are children of the root.
+ *
+ * Lock ordering is child group -> parent group -> timer base.
+ */
+#include <linux/cpu.h>
+#include <linux/cpuhotplug.h>
+#include <linux/jiffies.h>
+#include <linux/mutex.h>
+#include <linux/slab.h>
+#include <linux/smp.h>
+#include <linux/spinlock.h>
+#include <linux/tick.h>
+#include <linux/topology.h>
+
+#include "tick-internal.h"
+#include "timer_migration.h"
+
+DEFINE_STATIC_KEY_FALSE(tmigr_enabled_key);
+
+static DEFINE_PER_CPU(struct tmigr_cpu, tmigr_cpu);
+
+/* Protects the creation of groups */
+static DEFINE_MUTEX(tmigr_mutex);
+static struct list_head tmigr_level_list[TMIGR_LVL_ROOT];
+static struct tmigr_group *tmigr_root;
+
+/*
+ * Groups on the same path are locked bottom up, the level is used as
+ * lockdep subclass.
+ */
+static inline void tmigr_lock(struct tmigr_group *group)
+{
+	raw_spin_lock_nested(&group->lock, group->level);
+}
+
+static inline void tmigr_unlock(struct tmigr_group *group)
+{
+	raw_spin_unlock(&group->lock);
+}
+
+/*
+ * Update the expiry of @evt queued in @group. An expiry of KTIME_MAX
+ * removes the event. Returns true if the first expiry of @group changed.
+ */
+static bool tmigr_requeue(struct tmigr_group *group, struct tmigr_event *evt,
+			  u64 expires)
+{
+	struct timerqueue_node *next;
+	u64 old = group->next_expiry;
+
+	if (timerqueue_node_queued(&evt->nextevt))
+		timerqueue_del(&group->events, &evt->nextevt);
+
+	if (expires != KTIME_MAX) {
+		evt->nextevt.expires = expires;
+		timerqueue_add(&group->events, &evt->nextevt);
+	}
+
+	next = timerqueue_getnext(&group->events);
+	WRITE_ONCE(group->next_expiry, next ? next->expires : KTIME_MAX);
+
+	return group->next_expiry != old;
+}
+
+/* Returns true if @group was idle before. */
+static bool tmigr_child_active(struct tmigr_group *group, int id)
+{
+	__set_bit(id, group->active);
+	if (group->migrator == TMIGR_NONE)
+		WRITE_ONCE(group->migrator, id);
+	return ++group->num_active == 1;
+}
+
+/* Returns true if @group is idle now. */
+static bool tmigr_child_idle(struct tmigr_group *group, int id)
+{
+	__clear_bit(id, group->active);
+	if (--group->num_active) {
+		if (group->migrator == id)
+			WRITE_ONCE(group->migrator,
+				   find_first_bit(group->active, nr_cpu_ids));
+		return false;
+	}
+	WRITE_ONCE(group->migrator, TMIGR_NONE);
+	return true;
+}
+
+/*
+ * Walk up from the locked @group and make the first event of each idle
+ * group known to its parent, as long as something changes. @idle tells
+ * whether @group just became idle. Unlocks the last group it looked at.
+ *
+ * Returns the first expiry of the root if the walk reached an idle root,
+ * KTIME_MAX otherwise. The caller has to wake up for it.
+ */
+static u64 tmigr_propagate(struct tmigr_group *group, bool idle)
+{
+	struct tmigr_group *parent;
+	u64 ret = KTIME_MAX;
+	bool changed;
+
+	for (;;) {
+		parent = group->parent;
+		if (group->num_active)
+			break;
+		if (!parent) {
+			ret = group->next_expiry;
+			break;
+		}
+
+		tmigr_lock(parent);
+		changed = tmigr_requeue(parent, &group->groupevt,
+					group->next_expiry);
+		if (idle) {
+			idle = tmigr_child_idle(parent, group->id);
+			changed = true;
+		}
+		tmigr_unlock(group);
+		group = parent;
+		if (!changed)
+			break;
+	}
+	tmigr_unlock(group);
+
+	return ret;
+}
+
+/**
+ * tmigr_cpu_activate - take the global timers back from the hierarchy
+ *
+ * Called with interrupts disabled when the CPU leaves idle.
+ */
+void tmigr_cpu_activate(void)
+{
+	struct tmigr_cpu *tmc = this_cpu_ptr(&tmigr_cpu);
+	struct tmigr_group *group, *parent;
+	int id = smp_processor_id();
+
+	if (!tmc->online || !tmc->idle)
+		return;
+
+	tmc->wakeup = KTIME_MAX;
+
+	group = tmc->tmgroup;
+	tmigr_lock(group);
+	tmc->idle = false;
+	tmigr_requeue(group, &tmc->cpuevt, KTIME_MAX);
+
+	while (tmigr_child_active(group, id) && (parent = group->parent)) {
+		tmigr_lock(parent);
+		tmigr_requeue(parent, &group->groupevt, KTIME_MAX);
+		tmigr_unlock(group);
+		id = group->id;
+		group = parent;
+	}
+	tmigr_unlock(group);
+}
+
+/**
+ * tmigr_cpu_deactivate - hand the global timers over to the hierarchy
+ * @nextevt:	first expiry of the global timers of this CPU in 64 bit
+ *		jiffies, or KTIME_MAX
+ *
+ * Called with interrupts disabled when the CPU is about to stop the tick
+ * in idle. May be called again while the CPU is idle to update @nextevt.
+ *
+ * Returns the expiry in 64 bit jiffies this CPU has to wake up for on
+ * behalf of the hierarchy, which is @nextevt itself when the CPU does
+ * not take part in the hierarchy, or KTIME_MAX.
+ */
+u64 tmigr_cpu_deactivate(u64 nextevt)
+{
+	struct tmigr_cpu *tmc = this_cpu_ptr(&tmigr_cpu);
+	struct tmigr_group *group;
+	bool idle = false;
+	u64 wakeup;
+
+	if (!tmc->online)
+		return nextevt;
+
+	group = tmc->tmgroup;
+	tmigr_lock(group);
+	if (!tmc->idle) {
+		tmc->idle = true;
+		idle = tmigr_child_idle(group, smp_processor_id());
+	}
+	tmigr_requeue(group, &tmc->cpuevt, nextevt);
+
+	wakeup = tmigr_propagate(group, idle);
+	if (wakeup != KTIME_MAX)
+		tmc->wakeup = wakeup;
+
+	return tmc->wakeup;
+}
+
+/*
+ * Expire the global timers of the idle CPU @cpu and requeue its event
+ * with the new first expiry. The event was queued in @group, the cache
+ * group of @cpu.
+ */
+static void tmigr_handle_cpu(struct tmigr_group *group, unsigned int cpu,
+			     u64 now)
+{
+	struct tmigr_cpu *tmc = per_cpu_ptr(&tmigr_cpu, cpu);
+	u64 next;
+	bool idle;
+
+	local_irq_disable();
+	tmigr_lock(group);
+	idle = tmc->online && tmc->idle;
+	tmigr_unlock(group);
+	local_irq_enable();
+
+	/*
+	 * An event removed by tmigr_cpu_offline() is never handed out again,
+	 * and the CPU cannot die before this softirq completes as the
+	 * teardown goes through stop_machine().
+	 */
+	if (!idle)
+		return;
+
+	timer_expire_remote(cpu);
+
+	/*
+	 * Fetch the new first expiry under the group lock, so that it
+	 * cannot overwrite a newer one the CPU queued itself meanwhile.
+	 * If the base was busy with another expiry, look again next jiffy.
+	 */
+	local_irq_disable();
+	tmigr_lock(group);
+	if (tmc->online && tmc->idle &&
+	    !timerqueue_node_queued(&tmc->cpuevt.nextevt)) {
+		next = timer_global_next_expiry(cpu);
+		tmigr_requeue(group, &tmc->cpuevt, max(next, now + 1));
+	}
+	tmigr_unlock(group);
+	local_irq_enable();
+}
+
+/*
+ * Handle all expired events of @group. Returns the first expiry of the
+ * root if it is idle and was updated on the way, KTIME_MAX otherwise.
+ */
+static u64 tmigr_handle_group(struct tmigr_group *group, u64 now)
+{
+	struct timerqueue_node *node;
+	struct tmigr_event *evt;
+	u64 wakeup;
+
+	local_irq_disable();
+	tmigr_lock(group);
+	while ((node = timerqueue_getnext(&group->events)) &&
+	       node->expires <= now) {
+		evt = container_of(node, struct tmigr_event, nextevt);
+		tmigr_requeue(group, evt, KTIME_MAX);
+		tmigr_unlock(group);
+		local_irq_enable();
+
+		/*
+		 * An idle child group requeues its event in @group itself
+		 * once it has been handled.
+		 */
+		if (evt->group)
+			tmigr_handle_group(evt->group, now);
+		else
+			tmigr_handle_cpu(group, evt->cpu, now);
+
+		local_irq_disable();
+		tmigr_lock(group);
+	}
+	wakeup = tmigr_propagate(group, false);
+	local_irq_enable();
+
+	return wakeup;
+}
+
+/**
+ * tmigr_requires_handle_remote - check for expired hierarchy events
+ *
+ * Called from the tick with interrupts disabled. Returns true if this CPU
+ * is the migrator of a group with expired events, or if it is idle and
+ * woke up for an event of the idle hierarchy.
+ */
+bool tmigr_requires_handle_remote(void)
+{
+	struct tmigr_cpu *tmc = this_cpu_ptr(&tmigr_cpu);
+	struct tmigr_group *group;
+	int id = smp_processor_id();
+	u64 now;
+
+	if (!tmc->online)
+		return false;
+
+	now = get_jiffies_64();
+	if (tmc->idle)
+		return tmc->wakeup <= now;
+
+	/*
+	 * Lockless checks, a stale value results either in a pointless
+	 * softirq or the events being handled one tick later.
+	 */
+	for (group = tmc->tmgroup; group && READ_ONCE(group->migrator) == id;
+	     id = group->id, group = group->parent) {
+		if (READ_ONCE(group->next_expiry) <= now)
+			return true;
+	}
+	return false;
+}
+
+/**
+ * tmigr_handle_remote - expire the timers of idle CPUs
+ *
+ * Called from the timer softirq. Handles the expired events of all groups
+ * this CPU is the migrator of. An idle CPU which woke up for an event of
+ * the idle hierarchy handles the root.
+ */
+void tmigr_handle_remote(void)
+{
+	struct tmigr_cpu *tmc = this_cpu_ptr(&tmigr_cpu);
+	struct tmigr_group *group;
+	int id = smp_processor_id();
+	u64 now, wakeup;
+	bool idle;
+
+	if (!tmc->online)
+		return;
+
+	now = get_jiffies_64();
+
+	local_irq_disable();
+	idle = tmc->idle;
+	if (idle) {
+		if (tmc->wakeup > now) {
+			local_irq_enable();
+			return;
+		}
+		tmc->wakeup = KTIME_MAX;
+	}
+	local_irq_enable();
+
+	if (idle) {
+		wakeup = tmigr_handle_group(tmigr_root, now);
+		local_irq_disable();
+		if (tmc->idle && wakeup != KTIME_MAX)
+			tmc->wakeup = wakeup;
+		local_irq_enable();
+		return;
+	}
+
+	for (group = tmc->tmgroup; group && READ_ONCE(group->migrator) == id;
+	     id = group->id, group = group->parent)
+		tmigr_handle_group(group, now);
+}
+
+static struct tmigr_group *tmigr_group_alloc(unsigned int level, int node,
+					     int id, struct tmigr_group *parent)
+{
+	struct tmigr_group *group;
+
+	group = kzalloc_node(sizeof(*group), GFP_KERNEL, node);
+	if (!group)
+		return NULL;
+
+	group->active = bitmap_zalloc(nr_cpu_ids, GFP_KERNEL);
+	if (!group->active) {
+		kfree(group);
+		return NULL;
+	}
+
+	raw_spin_lock_init(&group->lock);
+	timerqueue_init_head(&group->events);
+	timerqueue_init(&group->groupevt.nextevt);
+	group->groupevt.group = group;
+	group->next_expiry = KTIME_MAX;
+	group->migrator = TMIGR_NONE;
+	group->level = level;
+	group->numa_node = node;
+	group->id = id;
+	group->parent = parent;
+	if (level < TMIGR_LVL_ROOT)
+		list_add_tail(&group->list, &tmigr_level_list[level]);
+
+	return group;
+}
+
+static bool tmigr_cpus_share_cache(int cpu, int other)
+{
+#ifdef CONFIG_SCHED_MC
+	return cpumask_test_cpu(other, cpu_coregroup_mask(cpu));
+#else
+	return true;
+#endif
+}
+
+/*
+ * Add @cpu to the cache group of its last level cache, creating the cache
+ * and node groups as required. New groups start out idle.
+ */
+static int tmigr_add_cpu(unsigned int cpu)
+{
+	struct tmigr_cpu *tmc = per_cpu_ptr(&tmigr_cpu, cpu);
+	struct tmigr_group *group, *node_group = NULL;
+	int node = cpu_to_node(cpu);
+	int ret = 0;
+
+	mutex_lock(&tmigr_mutex);
+
+	list_for_each_entry(group, &tmigr_level_list[TMIGR_LVL_NODE], list) {
+		if (group->numa_node == node) {
+			node_group = group;
+			break;
+		}
+	}
+	if (!node_group) {
+		node_group = tmigr_group_alloc(TMIGR_LVL_NODE, node, cpu,
+					       tmigr_root);
+		if (!node_group) {
+			ret = -ENOMEM;
+			goto out;
+		}
+	}
+
+	list_for_each_entry(group, &tmigr_level_list[TMIGR_LVL_CACHE], list) {
+		if (group->parent == node_group &&
+		    tmigr_cpus_share_cache(cpu, group->id)) {
+			tmc->tmgroup = group;
+			goto out;
+		}
+	}
+
+	group = tmigr_group_alloc(TMIGR_LVL_CACHE, node, cpu, node_group);
+	if (!group) {
+		ret = -ENOMEM;
+		goto out;
+	}
+	tmc->tmgroup = group;
+out:
+	mutex_unlock(&tmigr_mutex);
+	return ret;
+}
+
+static int tmigr_cpu_online(unsigned int cpu)
+{
+	struct tmigr_cpu *tmc = this_cpu_ptr(&tmigr_cpu);
+	int ret;
+
+	if (!tmc->tmgroup) {
+		ret = tmigr_add_cpu(cpu);
+		if (ret)
+			return ret;
+		timerqueue_init(&tmc->cpuevt.nextevt);
+		tmc->cpuevt.cpu = cpu;
+	}
+
+	local_irq_disable();
+	tmc->wakeup = KTIME_MAX;
+	tmc->idle = true;
+	tmc->online = true;
+	tmigr_cpu_activate();
+	local_irq_enable();
+
+	return 0;
+}
+
+static void tmigr_trigger_active(void *unused)
+{
+	tmigr_cpu_activate();
+}
+
+static int tmigr_cpu_offline(unsigned int cpu)
+{
+	struct tmigr_cpu *tmc = this_cpu_ptr(&tmigr_cpu);
+	struct tmigr_group *group = tmc->tmgroup;
+	bool idle = false;
+	u64 wakeup;
+	int target;
+
+	local_irq_disable();
+	tmigr_lock(group);
+	if (!tmc->idle) {
+		tmc->idle = true;
+		idle = tmigr_child_idle(group, cpu);
+	}
+	/* The global timers are migrated by timers_dead_cpu() */
+	tmigr_requeue(group, &tmc->cpuevt, KTIME_MAX);
+	tmc->online = false;
+	wakeup = tmigr_propagate(group, idle);
+	local_irq_enable();
+
+	/*
+	 * This was the last active CPU. Kick another one, so that it picks
+	 * up the wakeup duty for the idle hierarchy when it goes idle again.
+	 */
+	if (wakeup != KTIME_MAX) {
+		target = cpumask_any_but(cpu_online_mask, cpu);
+		if (target < nr_cpu_ids)
+			smp_call_function_single(target, tmigr_trigger_active,
+						 NULL, 0);
+	}
+
+	return 0;
+}
+
+static int __init tmigr_init(void)
+{
+	int i, ret;
+
+	/*
+	 * nohz_full CPUs stop the tick while they are busy, so they can
+	 * neither be migrators nor be woken up by the hierarchy.
+	 */
+	if (tick_nohz_full_enabled())
+		return 0;
+
+	for (i = 0; i < TMIGR_LVL_ROOT; i++)
+		INIT_LIST_HEAD(&tmigr_level_list[i]);
+
+	tmigr_root = tmigr_group_alloc(TMIGR_LVL_ROOT, NUMA_NO_NODE, 0, NULL);
+	if (!tmigr_root)
+		return -ENOMEM;
+
+	ret = cpuhp_setup_state(CPUHP_AP_ONLINE_DYN, "tmigr:online",
+				tmigr_cpu_online, tmigr_cpu_offline);
+	if (ret < 0) {
+		pr_err("timer migration: hotplug setup failed: %d\n", ret);
+		return ret;
+	}
+
+	static_branch_enable(&tmigr_enabled_key);
+	return 0;
+}
+early_initcall(tmigr_init);
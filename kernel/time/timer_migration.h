@@ -0,0 +1,113 @@
+/* SPDX-License-Identifier: GPL-2.0 */
+#ifndef _KERNEL_TIME_MIGRATION_H
+#define _KERNEL_TIME_MIGRATION_H
+
+#ifdef CONFIG_TIMER_PULL_MIGRATION
+
+#include <linux/jump_label.h>
+#include <linux/spinlock.h>
+#include <linux/timerqueue.h>
+
+/*
+ * Levels of the timer migration hierarchy: CPUs sharing the last level
+ * cache form a group, the cache groups of a NUMA node form a node group
+ * and the node groups are children of a single root group.
+ */
+enum tmigr_level {
+	TMIGR_LVL_CACHE,
+	TMIGR_LVL_NODE,
+	TMIGR_LVL_ROOT,
+};
+
+#define TMIGR_NONE	(-1)
+
+/**
+ * struct tmigr_event - a first expiry queued in a group
+ * @nextevt:	timerqueue node, the expiry is in 64 bit jiffies
+ * @group:	the child group this event belongs to, or NULL for a CPU event
+ * @cpu:	the CPU this event belongs to if @group is NULL
+ */
+struct tmigr_event {
+	struct timerqueue_node	nextevt;
+	struct tmigr_group	*group;
+	unsigned int		cpu;
+};
+
+/**
+ * struct tmigr_group - a group of the timer migration hierarchy
+ * @lock:		protects all members below and the queued state of
+ *			the events of the children
+ * @parent:		the parent group, NULL for the root
+ * @groupevt:		the first event of this group, queued in @parent
+ *			while this group is idle
+ * @events:		the first events of the idle children
+ * @next_expiry:	the first expiry of @events or KTIME_MAX
+ * @active:		ids of the active children
+ * @num_active:		number of active children
+ * @migrator:		id of the active child which handles @events, or
+ *			TMIGR_NONE if the group is idle
+ * @level:		enum tmigr_level of the group
+ * @numa_node:		NUMA node the CPUs of the group belong to
+ * @id:			id of this group in @parent, its first CPU
+ * @list:		entry in the per level list of groups
+ *
+ * The id of a CPU child is the CPU number, the id of a group child is
+ * the number of the first CPU which was added to it.
+ */
+struct tmigr_group {
+	raw_spinlock_t		lock;
+	struct tmigr_group	*parent;
+	struct tmigr_event	groupevt;
+	struct timerqueue_head	events;
+	u64			next_expiry;
+	unsigned long		*active;
+	unsigned int		num_active;
+	int			migrator;
+	unsigned int		level;
+	int			numa_node;
+	int			id;
+	struct list_head	list;
+};
+
+/**
+ * struct tmigr_cpu - per CPU state of the timer migration hierarchy
+ * @tmgroup:	the cache group of the CPU
+ * @cpuevt:	first expiry of the global timers of the CPU, queued in
+ *		@tmgroup while the CPU is idle
+ * @wakeup:	expiry of the hierarchy this idle CPU has to wake up for,
+ *		or KTIME_MAX
+ * @online:	the CPU takes part in the hierarchy
+ * @idle:	the CPU handed its global timers to the hierarchy, protected
+ *		by @tmgroup->lock
+ */
+struct tmigr_cpu {
+	struct tmigr_group	*tmgroup;
+	struct tmigr_event	cpuevt;
+	u64			wakeup;
+	bool			online;
+	bool			idle;
+};
+
+DECLARE_STATIC_KEY_FALSE(tmigr_enabled_key);
+
+static inline bool tmigr_enabled(void)
+{
+	return static_branch_likely(&tmigr_enabled_key);
+}
+
+extern void tmigr_cpu_activate(void);
+extern u64 tmigr_cpu_deactivate(u64 nextevt);
+extern bool tmigr_requires_handle_remote(void);
+extern void tmigr_handle_remote(void);
+
+#else /* CONFIG_TIMER_PULL_MIGRATION */
+
+static inline bool tmigr_enabled(void) { return false; }
+static inline void tmigr_cpu_activate(void) { }
+static inline u64 tmigr_cpu_deactivate(u64 nextevt) { return nextevt; }
+static inline bool tmigr_requires_handle_remote(void) { return false; }
+static inline void tmigr_handle_remote(void) { }
+
+#endif /* !CONFIG_TIMER_PULL_MIGRATION */
+
+#endif /* _KERNEL_TIME_MIGRATION_H */
@@ -91,6 +91,48 @@ void on_each_cpu_cond(smp_cond_func_t cond_func, smp_call_func_t func,
 }
 EXPORT_SYMBOL(on_each_cpu_cond);
 
+static struct {
+	unsigned int nr;
+	smp_call_func_t func[SMP_CALL_BATCH_MAX];
+	void *info[SMP_CALL_BATCH_MAX];
+} up_call_batch;
+
+void smp_call_batch_add(const struct cpumask *mask,
+			smp_call_func_t func, void *info)
+{
+	unsigned int i;
+
+	if (!cpumask_test_cpu(0, mask))
+		return;
+
+	for (i = 0; i < up_call_batch.nr; i++) {
+		if (up_call_batch.func[i] == func &&
+		    up_call_batch.info[i] == info)
+			return;
+	}
+
+	if (up_call_batch.nr == SMP_CALL_BATCH_MAX)
+		smp_call_batch_kick(false);
+
+	up_call_batch.func[up_call_batch.nr] = func;
+	up_call_batch.info[up_call_batch.nr] = info;
+	up_call_batch.nr++;
+}
+EXPORT_SYMBOL_GPL(smp_call_batch_add);
+
+void smp_call_batch_kick(bool wait)
+{
+	unsigned long flags;
+	unsigned int i;
+
+	local_irq_save(flags);
+	for (i = 0; i < up_call_batch.nr; i++)
+		up_call_batch.func[i](up_call_batch.info[i]);
+	up_call_batch.nr = 0;
+	local_irq_restore(flags);
+}
+EXPORT_SYMBOL_GPL(smp_call_batch_kick);
+
 int smp_call_on_cpu(unsigned int cpu, int (*func)(void *), void *par, bool phys)
 {
 	int ret;
@@ -11,6 +11,8 @@
 #include <linux/cpu.h>
 #include <linux/irq_poll.h>
 #include <linux/delay.h>
+#include <linux/kthread.h>
+#include <linux/sched.h>
 
 static unsigned int irq_poll_budget __read_mostly = 256;
 
@@ -22,7 +24,8 @@ static DEFINE_PER_CPU(struct list_head, blk_cpu_iopoll);
  *
  * Description:
  *     Add this irq_poll structure to the pending poll list and trigger the
- *     raise of the blk iopoll softirq.
+ *     raise of the blk iopoll softirq. A threaded @iop wakes up its poll
+ *     thread instead.
  **/
 void irq_poll_sched(struct irq_poll *iop)
 {
@@ -33,6 +36,12 @@ void irq_poll_sched(struct irq_poll *iop)
 	if (test_and_set_bit(IRQ_POLL_F_SCHED, &iop->state))
 		return;
 
+	if (iop->thread) {
+		set_bit(IRQ_POLL_F_SCHED_THREADED, &iop->state);
+		wake_up_process(iop->thread);
+		return;
+	}
+
 	local_irq_save(flags);
 	list_add_tail(&iop->list, this_cpu_ptr(&blk_cpu_iopoll));
 	raise_softirq_irqoff(IRQ_POLL_SOFTIRQ);
@@ -50,7 +59,8 @@ EXPORT_SYMBOL(irq_poll_sched);
  **/
 static void __irq_poll_complete(struct irq_poll *iop)
 {
-	list_del(&iop->list);
+	/* A threaded @iop is never on a poll list, keep it self-linked. */
+	list_del_init(&iop->list);
 	smp_mb__before_atomic();
 	clear_bit_unlock(IRQ_POLL_F_SCHED, &iop->state);
 }
@@ -135,6 +145,74 @@ static void __latent_entropy irq_poll_softirq(struct softirq_action *h)
 	local_irq_enable();
 }
 
+static int irq_poll_thread_wait(struct irq_poll *iop)
+{
+	set_current_state(TASK_INTERRUPTIBLE);
+
+	while (!kthread_should_stop()) {
+		if (test_and_clear_bit(IRQ_POLL_F_SCHED_THREADED,
+				       &iop->state)) {
+			__set_current_state(TASK_RUNNING);
+			return 0;
+		}
+
+		schedule();
+		set_current_state(TASK_INTERRUPTIBLE);
+	}
+
+	__set_current_state(TASK_RUNNING);
+	return -1;
+}
+
+/*
+ * The poll thread of a threaded irq_poll instance. It applies the same
+ * weight and re-arm rules as irq_poll_softirq(), but it is a normal task:
+ * the scheduler decides where it runs and its time is accounted to it.
+ * The global budget only decides when to give up the CPU voluntarily.
+ */
+static int irq_poll_thread(void *data)
+{
+	struct irq_poll *iop = data;
+	int budget = irq_poll_budget;
+	unsigned long start_time = jiffies;
+
+	while (!irq_poll_thread_wait(iop)) {
+		int work, weight;
+
+		/* The poll callbacks expect to run with BHs disabled. */
+		local_bh_disable();
+
+		weight = iop->weight;
+		work = 0;
+		if (test_bit(IRQ_POLL_F_SCHED, &iop->state))
+			work = iop->poll(iop, weight);
+
+		/*
+		 * As in irq_poll_softirq(), consuming the whole weight
+		 * means the instance is still owned here: poll it again,
+		 * unless it is being disabled.
+		 */
+		if (work >= weight) {
+			if (test_bit(IRQ_POLL_F_DISABLE, &iop->state))
+				irq_poll_complete(iop);
+			else
+				set_bit(IRQ_POLL_F_SCHED_THREADED,
+					&iop->state);
+		}
+
+		local_bh_enable();
+
+		budget -= work;
+		if (budget <= 0 || time_after(jiffies, start_time)) {
+			cond_resched();
+			budget = irq_poll_budget;
+			start_time = jiffies;
+		}
+	}
+
+	return 0;
+}
+
 /**
  * irq_poll_disable - Disable iopoll on this @iop
  * @iop:      The parent iopoll structure
@@ -185,6 +263,57 @@ void irq_poll_init(struct irq_poll *iop, int weight, irq_poll_fn *poll_fn)
 }
 EXPORT_SYMBOL(irq_poll_init);
 
+/**
+ * irq_poll_init_threaded - Initialize this @iop to be polled by a thread
+ * @iop:      The parent iopoll structure
+ * @weight:   The default weight (or command completion budget)
+ * @poll_fn:  The handler to invoke
+ * @name:     Name of the poll thread, prefixed with "irq_poll/"
+ *
+ * Description:
+ *     Like irq_poll_init(), but the handler is invoked from a dedicated
+ *     kernel thread instead of the IRQ_POLL softirq. The thread must be
+ *     stopped with irq_poll_del() after irq_poll_disable(). If the thread
+ *     cannot be created, @iop is still initialized and uses the softirq.
+ **/
+int irq_poll_init_threaded(struct irq_poll *iop, int weight,
+			   irq_poll_fn *poll_fn, const char *name)
+{
+	struct task_struct *thread;
+
+	irq_poll_init(iop, weight, poll_fn);
+
+	thread = kthread_run(irq_poll_thread, iop, "irq_poll/%s", name);
+	if (IS_ERR(thread)) {
+		pr_warn("irq_poll: failed to create thread for %s, using softirq\n",
+			name);
+		return PTR_ERR(thread);
+	}
+
+	iop->thread = thread;
+	return 0;
+}
+EXPORT_SYMBOL(irq_poll_init_threaded);
+
+/**
+ * irq_poll_del - Release the resources of this @iop
+ * @iop:      The parent iopoll structure
+ *
+ * Description:
+ *     Stop the poll thread of an @iop set up by irq_poll_init_threaded().
+ *     The @iop must have been disabled by irq_poll_disable() before. This
+ *     is a nop for @iop instances polled from the softirq.
+ **/
+void irq_poll_del(struct irq_poll *iop)
+{
+	if (!iop->thread)
+		return;
+
+	kthread_stop(iop->thread);
+	iop->thread = NULL;
+}
+EXPORT_SYMBOL(irq_poll_del);
+
 static int irq_poll_cpu_dead(unsigned int cpu)
 {
 	/*
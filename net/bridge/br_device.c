@@ -410,6 +410,32 @@ static int br_del_slave(struct net_device *dev, struct net_device *slave_dev)
 	return br_del_if(br, slave_dev);
 }
 
+static int br_fill_forward_path(struct net_device_path_ctx *ctx,
+				struct net_device_path *path)
+{
+	struct net_bridge *br = netdev_priv(ctx->dev);
+	struct net_bridge_fdb_entry *f;
+	struct net_bridge_port *dst;
+
+	/* Egress tagging of VLAN filtering bridges is not described */
+	if (!ctx->daddr || br_opt_get(br, BROPT_VLAN_ENABLED))
+		return -1;
+
+	f = br_fdb_find_rcu(br, ctx->daddr, 0);
+	if (!f)
+		return -1;
+
+	dst = READ_ONCE(f->dst);
+	if (!dst || dst->state != BR_STATE_FORWARDING)
+		return -1;
+
+	path->type = DEV_PATH_BRIDGE;
+	path->dev = ctx->dev;
+	ctx->dev = dst->dev;
+
+	return 0;
+}
+
 static const struct ethtool_ops br_ethtool_ops = {
 	.get_drvinfo		 = br_getinfo,
 	.get_link		 = ethtool_op_get_link,
@@ -444,6 +470,7 @@ static const struct net_device_ops br_netdev_ops = {
 	.ndo_bridge_setlink	 = br_setlink,
 	.ndo_bridge_dellink	 = br_dellink,
 	.ndo_features_check	 = passthru_features_check,
+	.ndo_fill_forward_path	 = br_fill_forward_path,
 };
 
 static struct device_type br_type = {
@@ -643,7 +643,10 @@ int __zerocopy_sg_from_iter(struct sock *sk, struct sk_buff *skb,
 		skb->data_len += copied;
 		skb->len += copied;
 		skb->truesize += truesize;
-		if (sk && sk->sk_type == SOCK_STREAM) {
+		/* Stream sockets without memory accounting, like AF_UNIX,
+		 * charge their skbs to sk_wmem_alloc as datagram ones do.
+		 */
+		if (sk && sk->sk_type == SOCK_STREAM && sk_has_account(sk)) {
 			sk_wmem_queued_add(sk, truesize);
 			sk_mem_charge(sk, truesize);
 		} else {
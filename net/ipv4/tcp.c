@@ -288,6 +288,8 @@ EXPORT_SYMBOL(sysctl_tcp_mem);
 
 atomic_long_t tcp_memory_allocated;	/* Current allocated memory. */
 EXPORT_SYMBOL(tcp_memory_allocated);
+DEFINE_PER_CPU(int, tcp_memory_per_cpu_fw_alloc);
+EXPORT_PER_CPU_SYMBOL_GPL(tcp_memory_per_cpu_fw_alloc);
 
 #if IS_ENABLED(CONFIG_SMC)
 DEFINE_STATIC_KEY_FALSE(tcp_have_smc);
@@ -1751,7 +1753,8 @@ static int tcp_zerocopy_vm_insert_batch(struct vm_area_struct *vma,
 					unsigned long *insert_addr,
 					u32 *length_with_pending,
 					u32 *seq,
-					struct tcp_zerocopy_receive *zc)
+					struct tcp_zerocopy_receive *zc,
+					u32 total_bytes_to_map)
 {
 	unsigned long pages_remaining = pages_to_map;
 	int bytes_mapped;
@@ -1764,6 +1767,23 @@ static int tcp_zerocopy_vm_insert_batch(struct vm_area_struct *vma,
 	 */
 	*seq += bytes_mapped;
 	*insert_addr += bytes_mapped;
+	if (ret == -EBUSY &&
+	    (zc->flags & TCP_RECEIVE_ZEROCOPY_FLAG_TLB_CLEAN_HINT)) {
+		/* The caller promised a clean range and we skipped the zap,
+		 * but some page is still mapped: zap what is left and retry.
+		 */
+		u32 zap_len = total_bytes_to_map - *length_with_pending +
+			      PAGE_SIZE * pages_remaining;
+		unsigned long pages_left = pages_remaining;
+
+		pages += pages_to_map - pages_remaining;
+		zap_page_range(vma, *insert_addr, zap_len);
+		ret = vm_insert_pages(vma, *insert_addr, pages,
+				      &pages_remaining);
+		bytes_mapped = PAGE_SIZE * (pages_left - pages_remaining);
+		*seq += bytes_mapped;
+		*insert_addr += bytes_mapped;
+	}
 	if (ret) {
 		/* But if vm_insert_pages did fail, we have to unroll some state
 		 * we speculatively touched before.
@@ -1775,11 +1795,87 @@ static int tcp_zerocopy_vm_insert_batch(struct vm_area_struct *vma,
 	return ret;
 }
 
+static bool tcp_zerocopy_can_map_frag(const skb_frag_t *frag)
+{
+	return skb_frag_size(frag) == PAGE_SIZE && !skb_frag_off(frag);
+}
+
+/* Number of bytes from @offset up to the first page aligned frag of @skb,
+ * i.e. the unaligned head which has to be copied before pages can be mapped.
+ */
+static u32 tcp_zerocopy_head_len(const struct sk_buff *skb, u32 offset)
+{
+	u32 remaining = skb->len - offset;
+	const skb_frag_t *frags;
+	u32 head = 0;
+
+	if (skb_has_frag_list(skb))
+		return remaining;
+	if (offset < skb_headlen(skb)) {
+		head = skb_headlen(skb) - offset;
+		offset = skb_headlen(skb);
+	}
+	offset -= skb_headlen(skb);
+	frags = skb_shinfo(skb)->frags;
+	while (offset) {
+		if (skb_frag_size(frags) > offset) {
+			head += skb_frag_size(frags) - offset;
+			frags++;
+			break;
+		}
+		offset -= skb_frag_size(frags);
+		frags++;
+	}
+	while (head < remaining && !tcp_zerocopy_can_map_frag(frags)) {
+		head += skb_frag_size(frags);
+		frags++;
+	}
+	return min(head, remaining);
+}
+
+/* Copy up to @len bytes of the receive queue starting at @seq to the user
+ * copy buffer described by @msg, stopping before the urgent byte, which is
+ * left for tcp_recvmsg() to handle.
+ */
+static int tcp_zerocopy_copy(struct sock *sk, struct msghdr *msg, u32 *seq,
+			     u32 len)
+{
+	const struct tcp_sock *tp = tcp_sk(sk);
+	int copied = 0;
+
+	while ((u32)copied < len) {
+		struct sk_buff *skb;
+		u32 offset, used;
+		int err;
+
+		skb = tcp_recv_skb(sk, *seq, &offset);
+		if (!skb || offset >= skb->len)
+			break;
+		used = min_t(u32, len - copied, skb->len - offset);
+		if (tp->urg_data) {
+			u32 urg_offset = tp->urg_seq - *seq;
+
+			if (urg_offset < used)
+				used = urg_offset;
+			if (!used)
+				break;
+		}
+		err = skb_copy_datagram_msg(skb, offset, msg, used);
+		if (err)
+			return copied ? : err;
+		*seq += used;
+		copied += used;
+	}
+	return copied;
+}
+
 static int tcp_zerocopy_receive(struct sock *sk,
 				struct tcp_zerocopy_receive *zc)
 {
+	unsigned long copybuf_address = (unsigned long)zc->copybuf_address;
 	unsigned long address = (unsigned long)zc->address;
-	u32 length = 0, seq, offset, zap_len;
+	u32 length = 0, seq, offset, total_bytes_to_map;
+	s32 copybuf_len = zc->copybuf_len;
 	#define PAGE_BATCH_SIZE 8
 	struct page *pages[PAGE_BATCH_SIZE];
 	const skb_frag_t *frags = NULL;
@@ -1788,11 +1884,24 @@ static int tcp_zerocopy_receive(struct sock *sk,
 	unsigned long pg_idx = 0;
 	unsigned long curr_addr;
 	struct tcp_sock *tp;
+	struct msghdr msg = {};
+	struct iovec iov;
+	int copied = 0;
 	int inq;
 	int ret;
 
+	zc->copybuf_len = 0;
+	zc->copybuf_head_len = 0;
+
 	if (address & (PAGE_SIZE - 1) || address != zc->address)
 		return -EINVAL;
+	if (zc->flags & ~(TCP_RECEIVE_ZEROCOPY_FLAG_TLB_CLEAN_HINT |
+			  TCP_RECEIVE_ZEROCOPY_FLAG_COPY_HEAD) ||
+	    zc->msg_control || zc->msg_controllen || zc->msg_flags ||
+	    zc->reserved || zc->reserved2)
+		return -EINVAL;
+	if (copybuf_len < 0 || copybuf_address != zc->copybuf_address)
+		return -EINVAL;
 
 	if (sk->sk_state == TCP_LISTEN)
 		return -ENOTCONN;
@@ -1800,22 +1909,77 @@ static int tcp_zerocopy_receive(struct sock *sk,
 	sock_rps_record_flow(sk);
 
 	tp = tcp_sk(sk);
+	seq = tp->copied_seq;
+	inq = tcp_inq(sk);
+
+	if (copybuf_len) {
+		ret = import_single_range(READ, (void __user *)copybuf_address,
+					  copybuf_len, &iov, &msg.msg_iter);
+		if (ret)
+			return ret;
+	}
+
+	/* Everything fits in the copy buffer: do not bother mapping. */
+	if (inq && inq <= copybuf_len) {
+		zc->length = 0;
+		zc->recv_skip_hint = 0;
+		copied = tcp_zerocopy_copy(sk, &msg, &seq, inq);
+		ret = 0;
+		goto out_copied;
+	}
+
+	if (inq < PAGE_SIZE) {
+		zc->length = 0;
+		zc->recv_skip_hint = inq;
+		if (!inq && sock_flag(sk, SOCK_DONE))
+			return -EIO;
+		return 0;
+	}
+
+	if (copybuf_len && (zc->flags & TCP_RECEIVE_ZEROCOPY_FLAG_COPY_HEAD)) {
+		skb = tcp_recv_skb(sk, seq, &offset);
+		if (skb) {
+			u32 head = tcp_zerocopy_head_len(skb, offset);
+
+			head = min_t(u32, head, copybuf_len);
+			if (head)
+				copied = tcp_zerocopy_copy(sk, &msg, &seq,
+							   head);
+			if (copied != head) {
+				zc->length = 0;
+				zc->recv_skip_hint = 0;
+				ret = 0;
+				goto out_copied;
+			}
+			zc->copybuf_head_len = copied;
+			inq -= copied;
+			skb = NULL;
+		}
+	}
 
 	mmap_read_lock(current->mm);
 
 	vma = find_vma(current->mm, address);
 	if (!vma || vma->vm_start > address || vma->vm_ops != &tcp_vm_ops) {
 		mmap_read_unlock(current->mm);
-		return -EINVAL;
+		if (!copied)
+			return -EINVAL;
+		/* Still report the head we consumed. */
+		zc->length = 0;
+		zc->recv_skip_hint = 0;
+		ret = 0;
+		goto out_copied;
 	}
 	zc->length = min_t(unsigned long, zc->length, vma->vm_end - address);
-
-	seq = tp->copied_seq;
-	inq = tcp_inq(sk);
 	zc->length = min_t(u32, zc->length, inq);
-	zap_len = zc->length & ~(PAGE_SIZE - 1);
-	if (zap_len) {
-		zap_page_range(vma, address, zap_len);
+	total_bytes_to_map = zc->length & ~(PAGE_SIZE - 1);
+	if (total_bytes_to_map) {
+		/* Only walk the page tables upfront if the caller did not
+		 * promise the range is already unmapped; otherwise a busy
+		 * page is handled lazily by tcp_zerocopy_vm_insert_batch().
+		 */
+		if (!(zc->flags & TCP_RECEIVE_ZEROCOPY_FLAG_TLB_CLEAN_HINT))
+			zap_page_range(vma, address, total_bytes_to_map);
 		zc->recv_skip_hint = 0;
 	} else {
 		zc->recv_skip_hint = zc->length;
@@ -1827,10 +1991,8 @@ static int tcp_zerocopy_receive(struct sock *sk,
 			/* If we're here, finish the current batch. */
 			if (pg_idx) {
 				ret = tcp_zerocopy_vm_insert_batch(vma, pages,
-								   pg_idx,
-								   &curr_addr,
-								   &length,
-								   &seq, zc);
+						pg_idx, &curr_addr, &length,
+						&seq, zc, total_bytes_to_map);
 				if (ret)
 					goto out;
 				pg_idx = 0;
@@ -1855,11 +2017,10 @@ static int tcp_zerocopy_receive(struct sock *sk,
 				frags++;
 			}
 		}
-		if (skb_frag_size(frags) != PAGE_SIZE || skb_frag_off(frags)) {
+		if (!tcp_zerocopy_can_map_frag(frags)) {
 			int remaining = zc->recv_skip_hint;
 
-			while (remaining && (skb_frag_size(frags) != PAGE_SIZE ||
-					     skb_frag_off(frags))) {
+			while (remaining && !tcp_zerocopy_can_map_frag(frags)) {
 				remaining -= skb_frag_size(frags);
 				frags++;
 			}
@@ -1874,7 +2035,8 @@ static int tcp_zerocopy_receive(struct sock *sk,
 		if (pg_idx == PAGE_BATCH_SIZE) {
 			ret = tcp_zerocopy_vm_insert_batch(vma, pages, pg_idx,
 							   &curr_addr, &length,
-							   &seq, zc);
+							   &seq, zc,
+							   total_bytes_to_map);
 			if (ret)
 				goto out;
 			pg_idx = 0;
@@ -1883,17 +2045,34 @@ static int tcp_zerocopy_receive(struct sock *sk,
 	if (pg_idx) {
 		ret = tcp_zerocopy_vm_insert_batch(vma, pages, pg_idx,
 						   &curr_addr, &length, &seq,
-						   zc);
+						   zc, total_bytes_to_map);
 	}
 out:
 	mmap_read_unlock(current->mm);
-	if (length) {
+	/* Copy the unaligned tail the mapping stopped at, if there is room. */
+	if (!ret && zc->recv_skip_hint && copied < copybuf_len) {
+		u32 tail = min_t(u32, zc->recv_skip_hint, copybuf_len - copied);
+		int err = tcp_zerocopy_copy(sk, &msg, &seq, tail);
+
+		if (err > 0) {
+			copied += err;
+			zc->recv_skip_hint -= err;
+		} else if (err < 0 && !copied) {
+			copied = err;
+		}
+	}
+out_copied:
+	/* copybuf_len reports the bytes copied, or the copy error. */
+	zc->copybuf_len = copied;
+	if (copied < 0)
+		copied = 0;
+	if (length + copied) {
 		WRITE_ONCE(tp->copied_seq, seq);
 		tcp_rcv_space_adjust(sk);
 
 		/* Clean up data we have read: This will do ACK frames. */
 		tcp_recv_skb(sk, seq, &offset);
-		tcp_cleanup_rbuf(sk, length);
+		tcp_cleanup_rbuf(sk, length + copied);
 		ret = 0;
 		if (length == zc->length)
 			zc->recv_skip_hint = 0;
@@ -3820,7 +3999,7 @@ static int do_tcp_getsockopt(struct sock *sk, int level,
 	}
 #ifdef CONFIG_MMU
 	case TCP_ZEROCOPY_RECEIVE: {
-		struct tcp_zerocopy_receive zc;
+		struct tcp_zerocopy_receive zc = {};
 		int err;
 
 		if (get_user(len, optlen))
@@ -3837,7 +4016,7 @@ static int do_tcp_getsockopt(struct sock *sk, int level,
 		lock_sock(sk);
 		err = tcp_zerocopy_receive(sk, &zc);
 		release_sock(sk);
-		if (len == sizeof(zc))
+		if (len >= offsetofend(struct tcp_zerocopy_receive, err))
 			goto zerocopy_rcv_sk_err;
 		switch (len) {
 		case offsetofend(struct tcp_zerocopy_receive, err):
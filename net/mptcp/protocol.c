@@ -812,39 +812,90 @@ static void mptcp_nospace(struct mptcp_sock *msk, struct socket *sock)
 	set_bit(SOCK_NOSPACE, &sock->flags);
 }
 
-static struct sock *mptcp_subflow_get_send(struct mptcp_sock *msk)
+static struct sock *mptcp_subflow_get_send(struct mptcp_sock *msk,
+					   struct mptcp_sched_data *data)
 {
-	struct mptcp_subflow_context *subflow;
-	struct sock *backup = NULL;
+	struct sock *ssk;
 
 	sock_owned_by_me((const struct sock *)msk);
 
 	if (!mptcp_ext_cache_refill(msk))
 		return NULL;
 
-	mptcp_for_each_subflow(msk, subflow) {
-		struct sock *ssk = mptcp_subflow_tcp_sock(subflow);
+	ssk = mptcp_sched_get_subflow(msk, data, false);
+	if (ssk && !sk_stream_memory_free(ssk)) {
+		struct socket *sock = ssk->sk_socket;
+
+		if (sock)
+			mptcp_nospace(msk, sock);
 
-		if (!sk_stream_memory_free(ssk)) {
-			struct socket *sock = ssk->sk_socket;
+		return NULL;
+	}
 
-			if (sock)
-				mptcp_nospace(msk, sock);
+	return ssk;
+}
 
-			return NULL;
-		}
+/* Copy the last @len bytes just queued on @primary to the other subflows
+ * selected by the scheduler. Data is already in the tail fragment of the
+ * rtx queue, send it the same way the worker retransmits it.
+ */
+static void mptcp_push_redundant(struct sock *sk, struct sock *primary,
+				 const struct mptcp_sched_data *data, int len)
+{
+	struct mptcp_data_frag *dfrag = mptcp_rtx_tail(sk);
+	struct mptcp_sock *msk = mptcp_sk(sk);
+	unsigned long scheduled = data->scheduled;
+	int orig_len, orig_offset, i;
+	struct msghdr msg = {
+		.msg_flags = MSG_DONTWAIT,
+	};
+	u64 orig_write_seq;
+	long timeo = 0;
+
+	if (!dfrag)
+		return;
+
+	orig_len = dfrag->data_len;
+	orig_offset = dfrag->offset;
+	orig_write_seq = dfrag->data_seq;
 
-		if (subflow->backup) {
-			if (!backup)
-				backup = ssk;
+	for_each_set_bit(i, &scheduled, data->nr_subflows) {
+		struct sock *ssk = mptcp_subflow_tcp_sock(data->subflows[i].context);
+		int mss_now = 0, size_goal = 0;
+		size_t copied = 0;
 
+		if (ssk == primary || !sk_stream_memory_free(ssk))
 			continue;
-		}
 
-		return ssk;
+		dfrag->data_seq = orig_write_seq + orig_len - len;
+		dfrag->offset = orig_offset + orig_len - len;
+		dfrag->data_len = len;
+
+		lock_sock_nested(ssk, SINGLE_DEPTH_NESTING);
+		while (dfrag->data_len > 0) {
+			int ret;
+
+			if (!mptcp_ext_cache_refill(msk))
+				break;
+
+			ret = mptcp_sendmsg_frag(sk, ssk, &msg, dfrag, &timeo,
+						 &mss_now, &size_goal);
+			if (ret <= 0)
+				break;
+
+			copied += ret;
+			dfrag->data_len -= ret;
+			dfrag->offset += ret;
+		}
+		if (copied)
+			tcp_push(ssk, msg.msg_flags, mss_now,
+				 tcp_sk(ssk)->nonagle, size_goal);
+		release_sock(ssk);
 	}
 
-	return backup;
+	dfrag->data_seq = orig_write_seq;
+	dfrag->offset = orig_offset;
+	dfrag->data_len = orig_len;
 }
 
 static void ssk_check_wmem(struct mptcp_sock *msk, struct sock *ssk)
@@ -863,6 +914,7 @@ static int mptcp_sendmsg(struct sock *sk, struct msghdr *msg, size_t len)
 {
 	int mss_now = 0, size_goal = 0, ret = 0;
 	struct mptcp_sock *msk = mptcp_sk(sk);
+	struct mptcp_sched_data data;
 	struct page_frag *pfrag;
 	size_t copied = 0;
 	struct sock *ssk;
@@ -892,7 +944,7 @@ static int mptcp_sendmsg(struct sock *sk, struct msghdr *msg, size_t len)
 	}
 
 	__mptcp_flush_join_list(msk);
-	ssk = mptcp_subflow_get_send(msk);
+	ssk = mptcp_subflow_get_send(msk, &data);
 	while (!sk_stream_memory_free(sk) ||
 	       !ssk ||
 	       !mptcp_page_frag_refill(ssk, pfrag)) {
@@ -915,7 +967,7 @@ static int mptcp_sendmsg(struct sock *sk, struct msghdr *msg, size_t len)
 
 		mptcp_clean_una(sk);
 
-		ssk = mptcp_subflow_get_send(msk);
+		ssk = mptcp_subflow_get_send(msk, &data);
 		if (list_empty(&msk->conn_list)) {
 			ret = -ENOTCONN;
 			goto out;
@@ -940,6 +992,10 @@ static int mptcp_sendmsg(struct sock *sk, struct msghdr *msg, size_t len)
 
 		copied += ret;
 
+		/* more than one subflow scheduled: send copies */
+		if (data.scheduled & (data.scheduled - 1))
+			mptcp_push_redundant(sk, ssk, &data, ret);
+
 		tx_ok = msg_data_left(msg);
 		if (!tx_ok)
 			break;
@@ -1302,12 +1358,12 @@ static void mptcp_retransmit_timer(struct timer_list *t)
 /* Find an idle subflow.  Return NULL if there is unacked data at tcp
  * level.
  *
- * A backup subflow is returned only if that is the only kind available.
+ * Which subflow is used is up to the scheduler.
  */
-static struct sock *mptcp_subflow_get_retrans(const struct mptcp_sock *msk)
+static struct sock *mptcp_subflow_get_retrans(struct mptcp_sock *msk)
 {
 	struct mptcp_subflow_context *subflow;
-	struct sock *backup = NULL;
+	struct mptcp_sched_data data;
 
 	sock_owned_by_me((const struct sock *)msk);
 
@@ -1317,17 +1373,9 @@ static struct sock *mptcp_subflow_get_retrans(const struct mptcp_sock *msk)
 		/* still data outstanding at TCP level?  Don't retransmit. */
 		if (!tcp_write_queue_empty(ssk))
 			return NULL;
-
-		if (subflow->backup) {
-			if (!backup)
-				backup = ssk;
-			continue;
-		}
-
-		return ssk;
 	}
 
-	return backup;
+	return mptcp_sched_get_subflow(msk, &data, true);
 }
 
 /* subflow sockets can be either outgoing (connect) or incoming
@@ -1518,6 +1566,11 @@ static int mptcp_init_sock(struct sock *sk)
 	if (ret)
 		return ret;
 
+	rcu_read_lock();
+	mptcp_init_sched(mptcp_sk(sk),
+			 mptcp_sched_find(mptcp_get_scheduler(net)));
+	rcu_read_unlock();
+
 	ret = __mptcp_socket_create(mptcp_sk(sk));
 	if (ret)
 		return ret;
@@ -1725,6 +1778,8 @@ struct sock *mptcp_sk_clone(const struct sock *sk,
 	__mptcp_init_sock(nsk);
 
 	msk = mptcp_sk(nsk);
+	/* the scheduler pointer was copied from the listener */
+	mptcp_init_sched(msk, msk->sched);
 	msk->local_key = subflow_req->local_key;
 	msk->token = subflow_req->token;
 	msk->subflow = NULL;
@@ -1834,6 +1889,8 @@ static void mptcp_destroy(struct sock *sk)
 	if (msk->cached_ext)
 		__skb_ext_put(msk->cached_ext);
 
+	mptcp_release_sched(msk);
+
 	sk_sockets_allocated_dec(sk);
 }
 
@@ -1895,6 +1952,36 @@ static int mptcp_setsockopt_v6(struct mptcp_sock *msk, int optname,
 	return ret;
 }
 
+static int mptcp_setsockopt_sol_mptcp(struct mptcp_sock *msk, int optname,
+				      sockptr_t optval, unsigned int optlen)
+{
+	struct sock *sk = (struct sock *)msk;
+	int ret;
+
+	switch (optname) {
+	case MPTCP_SCHEDULER: {
+		char name[MPTCP_SCHED_NAME_MAX];
+
+		if (optlen < 1)
+			return -EINVAL;
+
+		ret = strncpy_from_sockptr(name, optval,
+					   min_t(long, MPTCP_SCHED_NAME_MAX - 1,
+						 optlen));
+		if (ret < 0)
+			return -EFAULT;
+		name[ret] = 0;
+
+		lock_sock(sk);
+		ret = mptcp_set_scheduler(msk, name);
+		release_sock(sk);
+		return ret;
+	}
+	}
+
+	return -ENOPROTOOPT;
+}
+
 static int mptcp_setsockopt(struct sock *sk, int level, int optname,
 			    sockptr_t optval, unsigned int optlen)
 {
@@ -1906,6 +1993,9 @@ static int mptcp_setsockopt(struct sock *sk, int level, int optname,
 	if (level == SOL_SOCKET)
 		return mptcp_setsockopt_sol_socket(msk, optname, optval, optlen);
 
+	if (level == SOL_MPTCP)
+		return mptcp_setsockopt_sol_mptcp(msk, optname, optval, optlen);
+
 	/* @@ the meaning of setsockopt() when the socket is connected and
 	 * there are multiple subflows is not yet defined. It is up to the
 	 * MPTCP-level socket to configure the subflows until the subflow
@@ -1924,6 +2014,34 @@ static int mptcp_setsockopt(struct sock *sk, int level, int optname,
 	return -EOPNOTSUPP;
 }
 
+static int mptcp_getsockopt_sol_mptcp(struct mptcp_sock *msk, int optname,
+				      char __user *optval, int __user *optlen)
+{
+	struct sock *sk = (struct sock *)msk;
+	int len, ret = 0;
+
+	switch (optname) {
+	case MPTCP_SCHEDULER:
+		if (get_user(len, optlen))
+			return -EFAULT;
+
+		len = min_t(unsigned int, len, MPTCP_SCHED_NAME_MAX);
+		if (len < 0)
+			return -EINVAL;
+
+		if (put_user(len, optlen))
+			return -EFAULT;
+
+		lock_sock(sk);
+		if (copy_to_user(optval, msk->sched->name, len))
+			ret = -EFAULT;
+		release_sock(sk);
+		return ret;
+	}
+
+	return -ENOPROTOOPT;
+}
+
 static int mptcp_getsockopt(struct sock *sk, int level, int optname,
 			    char __user *optval, int __user *option)
 {
@@ -1932,6 +2050,9 @@ static int mptcp_getsockopt(struct sock *sk, int level, int optname,
 
 	pr_debug("msk=%p", msk);
 
+	if (level == SOL_MPTCP)
+		return mptcp_getsockopt_sol_mptcp(msk, optname, optval, option);
+
 	/* @@ the meaning of setsockopt() when the socket is connected and
 	 * there are multiple subflows is not yet defined. It is up to the
 	 * MPTCP-level socket to configure the subflows until the subflow
@@ -2119,6 +2240,7 @@ static struct proto mptcp_prot = {
 	.get_port	= mptcp_get_port,
 	.sockets_allocated	= &mptcp_sockets_allocated,
 	.memory_allocated	= &tcp_memory_allocated,
+	.per_cpu_fw_alloc	= &tcp_memory_per_cpu_fw_alloc,
 	.memory_pressure	= &tcp_memory_pressure,
 	.stream_memory_free	= mptcp_memory_free,
 	.sysctl_wmem_offset	= offsetof(struct net, ipv4.sysctl_tcp_wmem),
@@ -2419,6 +2541,7 @@ void __init mptcp_proto_init(void)
 
 	mptcp_subflow_init();
 	mptcp_pm_init();
+	mptcp_sched_init();
 	mptcp_token_init();
 
 	if (proto_register(&mptcp_prot, 1) != 0)
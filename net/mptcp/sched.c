@@ -0,0 +1,245 @@
+// SPDX-License-Identifier: GPL-2.0
+/* Multipath TCP
+ *
+ * Packet schedulers: pick the subflows new data and retransmissions are
+ * sent on.
+ */
+#define pr_fmt(fmt) "MPTCP: " fmt
+
+#include <linux/kernel.h>
+#include <linux/module.h>
+#include <linux/list.h>
+#include <linux/rculist.h>
+#include <linux/spinlock.h>
+#include <linux/bpf.h>
+#include <net/tcp.h>
+#include <net/mptcp.h>
+#include "protocol.h"
+
+static DEFINE_SPINLOCK(mptcp_sched_list_lock);
+static LIST_HEAD(mptcp_sched_list);
+
+/* Pick the first non-backup subflow, or the first backup one if that's the
+ * only kind available.
+ */
+static int mptcp_sched_default_get_subflow(struct mptcp_sock *msk,
+					   struct mptcp_sched_data *data)
+{
+	int i, backup = -1;
+
+	for (i = 0; i < data->nr_subflows; i++) {
+		if (!data->subflows[i].backup) {
+			data->scheduled = BIT(i);
+			return 0;
+		}
+
+		if (backup < 0)
+			backup = i;
+	}
+
+	if (backup < 0)
+		return -ENOENT;
+
+	data->scheduled = BIT(backup);
+	return 0;
+}
+
+static struct mptcp_sched_ops mptcp_sched_default = {
+	.get_subflow	= mptcp_sched_default_get_subflow,
+	.name		= "default",
+	.owner		= THIS_MODULE,
+};
+
+/* Send new data on all the non-backup subflows that can queue it, or on
+ * all the backup ones if there are none. Retransmissions are left to the
+ * default policy: they are already redundant.
+ */
+static int mptcp_sched_redundant_get_subflow(struct mptcp_sock *msk,
+					     struct mptcp_sched_data *data)
+{
+	u32 active = 0, backup = 0;
+	int i;
+
+	if (data->reinject)
+		return mptcp_sched_default_get_subflow(msk, data);
+
+	for (i = 0; i < data->nr_subflows; i++) {
+		if (!data->subflows[i].memory_free)
+			continue;
+
+		if (data->subflows[i].backup)
+			backup |= BIT(i);
+		else
+			active |= BIT(i);
+	}
+
+	data->scheduled = active ? : backup;
+	if (!data->scheduled)
+		return mptcp_sched_default_get_subflow(msk, data);
+
+	return 0;
+}
+
+static struct mptcp_sched_ops mptcp_sched_redundant = {
+	.get_subflow	= mptcp_sched_redundant_get_subflow,
+	.name		= "redundant",
+	.owner		= THIS_MODULE,
+};
+
+/* Must be called with rcu lock held */
+struct mptcp_sched_ops *mptcp_sched_find(const char *name)
+{
+	struct mptcp_sched_ops *sched;
+
+	list_for_each_entry_rcu(sched, &mptcp_sched_list, list) {
+		if (!strcmp(sched->name, name))
+			return sched;
+	}
+
+	return NULL;
+}
+
+int mptcp_register_scheduler(struct mptcp_sched_ops *sched)
+{
+	int ret = 0;
+
+	if (!sched->get_subflow) {
+		pr_err("%s does not implement required ops\n", sched->name);
+		return -EINVAL;
+	}
+
+	spin_lock(&mptcp_sched_list_lock);
+	if (mptcp_sched_find(sched->name)) {
+		pr_notice("%s already registered\n", sched->name);
+		ret = -EEXIST;
+	} else {
+		list_add_tail_rcu(&sched->list, &mptcp_sched_list);
+		pr_debug("%s registered\n", sched->name);
+	}
+	spin_unlock(&mptcp_sched_list_lock);
+
+	return ret;
+}
+EXPORT_SYMBOL_GPL(mptcp_register_scheduler);
+
+/* Sockets hold a reference on the scheduler owner, so this can't happen
+ * while any socket still uses it.
+ */
+void mptcp_unregister_scheduler(struct mptcp_sched_ops *sched)
+{
+	if (sched == &mptcp_sched_default)
+		return;
+
+	spin_lock(&mptcp_sched_list_lock);
+	list_del_rcu(&sched->list);
+	spin_unlock(&mptcp_sched_list_lock);
+
+	synchronize_rcu();
+}
+EXPORT_SYMBOL_GPL(mptcp_unregister_scheduler);
+
+void __init mptcp_sched_init(void)
+{
+	mptcp_register_scheduler(&mptcp_sched_default);
+	mptcp_register_scheduler(&mptcp_sched_redundant);
+}
+
+/* Takes a reference on @sched for @msk, falls back to the default scheduler
+ * if @sched is NULL or going away.
+ */
+void mptcp_init_sched(struct mptcp_sock *msk, struct mptcp_sched_ops *sched)
+{
+	if (!sched || !bpf_try_module_get(sched, sched->owner))
+		sched = &mptcp_sched_default;
+
+	msk->sched = sched;
+	if (sched->init)
+		sched->init(msk);
+}
+
+void mptcp_release_sched(struct mptcp_sock *msk)
+{
+	struct mptcp_sched_ops *sched = msk->sched;
+
+	if (!sched)
+		return;
+
+	msk->sched = NULL;
+	if (sched->release)
+		sched->release(msk);
+	bpf_module_put(sched, sched->owner);
+}
+
+/* called with msk socket lock held */
+int mptcp_set_scheduler(struct mptcp_sock *msk, const char *name)
+{
+	struct mptcp_sched_ops *sched;
+	int err = 0;
+
+	rcu_read_lock();
+	sched = mptcp_sched_find(name);
+	if (!sched) {
+		err = -ENOENT;
+	} else if (sched != msk->sched) {
+		if (bpf_try_module_get(sched, sched->owner)) {
+			mptcp_release_sched(msk);
+			msk->sched = sched;
+			if (sched->init)
+				sched->init(msk);
+		} else {
+			err = -EBUSY;
+		}
+	}
+	rcu_read_unlock();
+
+	return err;
+}
+
+/**
+ * mptcp_sched_get_subflow - ask the scheduler of msk for subflows to use
+ *
+ * Fills @data with a snapshot of the first MPTCP_SCHED_MAX_SUBFLOWS
+ * subflows and returns the first one the scheduler selected, or NULL.
+ * On return, data->scheduled only contains valid subflows.
+ * Called with msk socket lock held.
+ */
+struct sock *mptcp_sched_get_subflow(struct mptcp_sock *msk,
+				     struct mptcp_sched_data *data,
+				     bool reinject)
+{
+	struct mptcp_subflow_context *subflow;
+	int nr = 0;
+
+	sock_owned_by_me((const struct sock *)msk);
+
+	mptcp_for_each_subflow(msk, subflow) {
+		struct mptcp_sched_subflow *s = &data->subflows[nr];
+		struct sock *ssk = mptcp_subflow_tcp_sock(subflow);
+		const struct tcp_sock *tp = tcp_sk(ssk);
+
+		s->context = subflow;
+		s->srtt_us = tp->srtt_us;
+		s->snd_cwnd = tp->snd_cwnd;
+		s->packets_out = tp->packets_out;
+		s->mss_cache = tp->mss_cache;
+		s->pacing_rate = READ_ONCE(ssk->sk_pacing_rate);
+		s->backup = subflow->backup;
+		s->memory_free = sk_stream_memory_free(ssk);
+
+		if (++nr == MPTCP_SCHED_MAX_SUBFLOWS)
+			break;
+	}
+
+	data->nr_subflows = nr;
+	data->reinject = reinject;
+	data->scheduled = 0;
+	if (!nr || msk->sched->get_subflow(msk, data))
+		return NULL;
+
+	data->scheduled &= GENMASK(nr - 1, 0);
+	if (!data->scheduled)
+		return NULL;
+
+	subflow = data->subflows[__ffs(data->scheduled)].context;
+	return mptcp_subflow_tcp_sock(subflow);
+}
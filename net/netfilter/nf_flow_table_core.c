@@ -79,8 +79,8 @@ static int flow_offload_fill_route(struct flow_offload *flow,
 				   enum flow_offload_tuple_dir dir)
 {
 	struct flow_offload_tuple *flow_tuple = &flow->tuplehash[dir].tuple;
-	struct dst_entry *other_dst = route->tuple[!dir].dst;
 	struct dst_entry *dst = route->tuple[dir].dst;
+	int i;
 
 	if (!dst_hold_safe(route->tuple[dir].dst))
 		return -1;
@@ -94,9 +94,23 @@ static int flow_offload_fill_route(struct flow_offload *flow,
 		break;
 	}
 
-	flow_tuple->iifidx = other_dst->dev->ifindex;
+	flow_tuple->iifidx = route->tuple[dir].in.ifindex;
+	for (i = 0; i < route->tuple[dir].in.num_encaps; i++) {
+		flow_tuple->encap[i].id = route->tuple[dir].in.encap[i].id;
+		flow_tuple->encap[i].proto = route->tuple[dir].in.encap[i].proto;
+	}
+	flow_tuple->encap_num = route->tuple[dir].in.num_encaps;
 	flow_tuple->dst_cache = dst;
 
+	flow_tuple->xmit_type = route->tuple[dir].xmit_type;
+	if (flow_tuple->xmit_type == FLOW_OFFLOAD_XMIT_DIRECT) {
+		flow_tuple->out.ifidx = route->tuple[dir].out.ifindex;
+		memcpy(flow_tuple->out.h_source, route->tuple[dir].out.h_source,
+		       ETH_ALEN);
+		memcpy(flow_tuple->out.h_dest, route->tuple[dir].out.h_dest,
+		       ETH_ALEN);
+	}
+
 	return 0;
 }
 
@@ -530,6 +544,20 @@ int nf_flow_table_init(struct nf_flowtable *flowtable)
 }
 EXPORT_SYMBOL_GPL(nf_flow_table_init);
 
+static bool flow_offload_tuple_uses_dev(const struct flow_offload_tuple *tuple,
+					const struct net_device *dev)
+{
+	if (tuple->iifidx == dev->ifindex)
+		return true;
+
+	/* act_ct flows carry no route */
+	if (tuple->dst_cache && tuple->dst_cache->dev == dev)
+		return true;
+
+	return tuple->xmit_type == FLOW_OFFLOAD_XMIT_DIRECT &&
+	       tuple->out.ifidx == dev->ifindex;
+}
+
 static void nf_flow_table_do_cleanup(struct flow_offload *flow, void *data)
 {
 	struct net_device *dev = data;
@@ -539,9 +567,12 @@ static void nf_flow_table_do_cleanup(struct flow_offload *flow, void *data)
 		return;
 	}
 
+	/* Flows can bypass stacked devices (VLAN, PPP, bridge) and transmit
+	 * directly on lower devices: also match the devices routes point to.
+	 */
 	if (net_eq(nf_ct_net(flow->ct), dev_net(dev)) &&
-	    (flow->tuplehash[0].tuple.iifidx == dev->ifindex ||
-	     flow->tuplehash[1].tuple.iifidx == dev->ifindex))
+	    (flow_offload_tuple_uses_dev(&flow->tuplehash[0].tuple, dev) ||
+	     flow_offload_tuple_uses_dev(&flow->tuplehash[1].tuple, dev)))
 		flow_offload_teardown(flow);
 }
 
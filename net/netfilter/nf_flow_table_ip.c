@@ -7,6 +7,8 @@
 #include <linux/ip.h>
 #include <linux/ipv6.h>
 #include <linux/netdevice.h>
+#include <linux/if_ether.h>
+#include <linux/if_vlan.h>
 #include <net/ip.h>
 #include <net/ipv6.h>
 #include <net/ip6_route.h>
@@ -164,17 +166,75 @@ static bool ip_has_options(unsigned int thoff)
 	return thoff != sizeof(struct iphdr);
 }
 
+/* Check if @skb carries @proto in a VLAN header or PPPoE session, which is
+ * possible on lower devices of a flowtable, and add the size of the
+ * encapsulation header to @offset. Outer VLAN tags are already stripped.
+ */
+static bool nf_flow_skb_encap_protocol(struct sk_buff *skb, __be16 proto,
+				       u32 *offset)
+{
+	struct vlan_hdr *vhdr;
+
+	switch (skb->protocol) {
+	case htons(ETH_P_8021Q):
+		if (!pskb_may_pull(skb, VLAN_HLEN))
+			return false;
+
+		vhdr = (struct vlan_hdr *)skb_network_header(skb);
+		if (vhdr->h_vlan_encapsulated_proto == proto) {
+			*offset += VLAN_HLEN;
+			return true;
+		}
+		break;
+	case htons(ETH_P_PPP_SES):
+		if (nf_flow_pppoe_proto(skb) == proto) {
+			*offset += PPPOE_SES_HLEN;
+			return true;
+		}
+		break;
+	}
+
+	return false;
+}
+
+static void nf_flow_tuple_encap(struct sk_buff *skb,
+				struct flow_offload_tuple *tuple)
+{
+	struct vlan_hdr *vhdr;
+	struct pppoe_hdr *phdr;
+	int i = 0;
+
+	if (skb_vlan_tag_present(skb)) {
+		tuple->encap[i].id = skb_vlan_tag_get_id(skb);
+		tuple->encap[i].proto = skb->vlan_proto;
+		i++;
+	}
+
+	switch (skb->protocol) {
+	case htons(ETH_P_8021Q):
+		vhdr = (struct vlan_hdr *)skb_network_header(skb);
+		tuple->encap[i].id = ntohs(vhdr->h_vlan_TCI) & VLAN_VID_MASK;
+		tuple->encap[i].proto = skb->protocol;
+		break;
+	case htons(ETH_P_PPP_SES):
+		phdr = (struct pppoe_hdr *)skb_network_header(skb);
+		tuple->encap[i].id = ntohs(phdr->sid);
+		tuple->encap[i].proto = skb->protocol;
+		break;
+	}
+}
+
 static int nf_flow_tuple_ip(struct sk_buff *skb, const struct net_device *dev,
-			    struct flow_offload_tuple *tuple)
+			    struct flow_offload_tuple *tuple, u32 offset)
 {
 	struct flow_ports *ports;
 	unsigned int thoff;
 	struct iphdr *iph;
 
-	if (!pskb_may_pull(skb, sizeof(*iph)))
+	if (!pskb_may_pull(skb, sizeof(*iph) + offset))
 		return -1;
 
-	iph = ip_hdr(skb);
+	iph = (struct iphdr *)(skb_network_header(skb) + offset);
 	thoff = iph->ihl * 4;
 
 	if (ip_is_fragment(iph) ||
@@ -188,11 +248,11 @@ static int nf_flow_tuple_ip(struct sk_buff *skb, const struct net_device *dev,
 	if (iph->ttl <= 1)
 		return -1;
 
-	thoff = iph->ihl * 4;
+	thoff = iph->ihl * 4 + offset;
 	if (!pskb_may_pull(skb, thoff + sizeof(*ports)))
 		return -1;
 
-	iph = ip_hdr(skb);
+	iph = (struct iphdr *)(skb_network_header(skb) + offset);
 	ports = (struct flow_ports *)(skb_network_header(skb) + thoff);
 
 	tuple->src_v4.s_addr	= iph->saddr;
@@ -202,6 +262,7 @@ static int nf_flow_tuple_ip(struct sk_buff *skb, const struct net_device *dev,
 	tuple->l3proto		= AF_INET;
 	tuple->l4proto		= iph->protocol;
 	tuple->iifidx		= dev->ifindex;
+	nf_flow_tuple_encap(skb, tuple);
 
 	return 0;
 }
@@ -236,6 +297,134 @@ static unsigned int nf_flow_xmit_xfrm(struct sk_buff *skb,
 	return NF_STOLEN;
 }
 
+static void nf_flow_encap_pop(struct sk_buff *skb,
+			      const struct flow_offload_tuple *tuple)
+{
+	struct vlan_hdr *vhdr;
+	int i;
+
+	for (i = 0; i < tuple->encap_num; i++) {
+		if (skb_vlan_tag_present(skb)) {
+			__vlan_hwaccel_clear_tag(skb);
+			continue;
+		}
+
+		switch (skb->protocol) {
+		case htons(ETH_P_8021Q):
+			vhdr = (struct vlan_hdr *)skb->data;
+			skb_pull_rcsum(skb, VLAN_HLEN);
+			vlan_set_encap_proto(skb, vhdr);
+			skb_reset_network_header(skb);
+			break;
+		case htons(ETH_P_PPP_SES):
+			skb->protocol = nf_flow_pppoe_proto(skb);
+			skb_pull_rcsum(skb, PPPOE_SES_HLEN);
+			skb_reset_network_header(skb);
+			break;
+		}
+	}
+}
+
+static void nf_flow_pppoe_push(struct sk_buff *skb, u16 id)
+{
+	__be16 proto = skb->protocol == htons(ETH_P_IP) ? htons(PPP_IP) :
+							   htons(PPP_IPV6);
+	struct pppoe_hdr *ph;
+
+	ph = (struct pppoe_hdr *)__skb_push(skb, PPPOE_SES_HLEN);
+	ph->ver = 1;
+	ph->type = 1;
+	ph->code = 0;
+	ph->sid = htons(id);
+	ph->length = htons(skb->len - sizeof(*ph));
+	*(__be16 *)(ph + 1) = proto;
+	skb->protocol = htons(ETH_P_PPP_SES);
+}
+
+static void nf_flow_vlan_push(struct sk_buff *skb, __be16 proto, u16 id)
+{
+	struct vlan_hdr *vhdr;
+
+	vhdr = (struct vlan_hdr *)__skb_push(skb, VLAN_HLEN);
+	vhdr->h_vlan_TCI = htons(id);
+	vhdr->h_vlan_encapsulated_proto = skb->protocol;
+	skb->protocol = proto;
+}
+
+/* Egress encapsulation of a flow direction is the ingress encapsulation of
+ * the opposite one: push it back from the innermost header, the outermost
+ * VLAN tag is left to the device.
+ */
+static void nf_flow_encap_push(struct sk_buff *skb,
+			       const struct flow_offload_tuple *other)
+{
+	int i;
+
+	for (i = other->encap_num - 1; i >= 0; i--) {
+		switch (other->encap[i].proto) {
+		case htons(ETH_P_8021Q):
+		case htons(ETH_P_8021AD):
+			if (!i)
+				__vlan_hwaccel_put_tag(skb, other->encap[i].proto,
+						       other->encap[i].id);
+			else
+				nf_flow_vlan_push(skb, other->encap[i].proto,
+						  other->encap[i].id);
+			break;
+		case htons(ETH_P_PPP_SES):
+			nf_flow_pppoe_push(skb, other->encap[i].id);
+			break;
+		}
+	}
+}
+
+/* PPP devices segment GSO packets in software, let them do it */
+static bool nf_flow_xmit_direct_ok(const struct flow_offload *flow,
+				   enum flow_offload_tuple_dir dir,
+				   const struct sk_buff *skb)
+{
+	const struct flow_offload_tuple *other = &flow->tuplehash[!dir].tuple;
+	int i;
+
+	if (flow->tuplehash[dir].tuple.xmit_type != FLOW_OFFLOAD_XMIT_DIRECT)
+		return false;
+
+	if (!skb_is_gso(skb))
+		return true;
+
+	for (i = 0; i < other->encap_num; i++) {
+		if (other->encap[i].proto == htons(ETH_P_PPP_SES))
+			return false;
+	}
+
+	return true;
+}
+
+static unsigned int nf_flow_xmit_direct(struct net *net, struct sk_buff *skb,
+					const struct flow_offload *flow,
+					enum flow_offload_tuple_dir dir)
+{
+	const struct flow_offload_tuple *tuple = &flow->tuplehash[dir].tuple;
+	const struct flow_offload_tuple *other = &flow->tuplehash[!dir].tuple;
+	struct net_device *outdev;
+
+	outdev = dev_get_by_index_rcu(net, tuple->out.ifidx);
+	if (!outdev)
+		return NF_DROP;
+
+	if (skb_cow_head(skb, other->encap_num * PPPOE_SES_HLEN +
+			      LL_RESERVED_SPACE(outdev)))
+		return NF_DROP;
+
+	skb->dev = outdev;
+	nf_flow_encap_push(skb, other);
+	dev_hard_header(skb, outdev, ntohs(skb->protocol), tuple->out.h_dest,
+			tuple->out.h_source, skb->len);
+	dev_queue_xmit(skb);
+
+	return NF_STOLEN;
+}
+
 unsigned int
 nf_flow_offload_ip_hook(void *priv, struct sk_buff *skb,
 			const struct nf_hook_state *state)
@@ -246,15 +435,17 @@ nf_flow_offload_ip_hook(void *priv, struct sk_buff *skb,
 	enum flow_offload_tuple_dir dir;
 	struct flow_offload *flow;
 	struct net_device *outdev;
+	unsigned int thoff, mtu;
+	u32 offset = 0;
 	struct rtable *rt;
-	unsigned int thoff;
 	struct iphdr *iph;
 	__be32 nexthop;
 
-	if (skb->protocol != htons(ETH_P_IP))
+	if (skb->protocol != htons(ETH_P_IP) &&
+	    !nf_flow_skb_encap_protocol(skb, htons(ETH_P_IP), &offset))
 		return NF_ACCEPT;
 
-	if (nf_flow_tuple_ip(skb, state->in, &tuple) < 0)
+	if (nf_flow_tuple_ip(skb, state->in, &tuple, offset) < 0)
 		return NF_ACCEPT;
 
 	tuplehash = flow_offload_lookup(flow_table, &tuple);
@@ -266,14 +457,16 @@ nf_flow_offload_ip_hook(void *priv, struct sk_buff *skb,
 	rt = (struct rtable *)flow->tuplehash[dir].tuple.dst_cache;
 	outdev = rt->dst.dev;
 
-	if (unlikely(nf_flow_exceeds_mtu(skb, flow->tuplehash[dir].tuple.mtu)))
+	mtu = flow->tuplehash[dir].tuple.mtu + offset;
+	if (unlikely(nf_flow_exceeds_mtu(skb, mtu)))
 		return NF_ACCEPT;
 
-	if (skb_try_make_writable(skb, sizeof(*iph)))
+	if (skb_try_make_writable(skb, sizeof(*iph) + offset))
 		return NF_DROP;
 
-	thoff = ip_hdr(skb)->ihl * 4;
-	if (nf_flow_state_check(flow, ip_hdr(skb)->protocol, skb, thoff))
+	iph = (struct iphdr *)(skb_network_header(skb) + offset);
+	thoff = iph->ihl * 4;
+	if (nf_flow_state_check(flow, iph->protocol, skb, thoff + offset))
 		return NF_ACCEPT;
 
 	flow_offload_refresh(flow_table, flow);
@@ -283,6 +476,8 @@ nf_flow_offload_ip_hook(void *priv, struct sk_buff *skb,
 		return NF_ACCEPT;
 	}
 
+	nf_flow_encap_pop(skb, &tuplehash->tuple);
+
 	if (nf_flow_nat_ip(flow, skb, thoff, dir) < 0)
 		return NF_DROP;
 
@@ -300,6 +495,9 @@ nf_flow_offload_ip_hook(void *priv, struct sk_buff *skb,
 		return nf_flow_xmit_xfrm(skb, state, &rt->dst);
 	}
 
+	if (nf_flow_xmit_direct_ok(flow, dir, skb))
+		return nf_flow_xmit_direct(state->net, skb, flow, dir);
+
 	skb->dev = outdev;
 	nexthop = rt_nexthop(rt, flow->tuplehash[!dir].tuple.src_v4.s_addr);
 	skb_dst_set_noref(skb, &rt->dst);
@@ -437,16 +635,16 @@ static int nf_flow_nat_ipv6(const struct flow_offload *flow,
 }
 
 static int nf_flow_tuple_ipv6(struct sk_buff *skb, const struct net_device *dev,
-			      struct flow_offload_tuple *tuple)
+			      struct flow_offload_tuple *tuple, u32 offset)
 {
 	struct flow_ports *ports;
 	struct ipv6hdr *ip6h;
 	unsigned int thoff;
 
-	if (!pskb_may_pull(skb, sizeof(*ip6h)))
+	if (!pskb_may_pull(skb, sizeof(*ip6h) + offset))
 		return -1;
 
-	ip6h = ipv6_hdr(skb);
+	ip6h = (struct ipv6hdr *)(skb_network_header(skb) + offset);
 
 	if (ip6h->nexthdr != IPPROTO_TCP &&
 	    ip6h->nexthdr != IPPROTO_UDP)
@@ -455,11 +653,11 @@ static int nf_flow_tuple_ipv6(struct sk_buff *skb, const struct net_device *dev,
 	if (ip6h->hop_limit <= 1)
 		return -1;
 
-	thoff = sizeof(*ip6h);
+	thoff = sizeof(*ip6h) + offset;
 	if (!pskb_may_pull(skb, thoff + sizeof(*ports)))
 		return -1;
 
-	ip6h = ipv6_hdr(skb);
+	ip6h = (struct ipv6hdr *)(skb_network_header(skb) + offset);
 	ports = (struct flow_ports *)(skb_network_header(skb) + thoff);
 
 	tuple->src_v6		= ip6h->saddr;
@@ -469,6 +667,7 @@ static int nf_flow_tuple_ipv6(struct sk_buff *skb, const struct net_device *dev,
 	tuple->l3proto		= AF_INET6;
 	tuple->l4proto		= ip6h->nexthdr;
 	tuple->iifidx		= dev->ifindex;
+	nf_flow_tuple_encap(skb, tuple);
 
 	return 0;
 }
@@ -486,11 +685,14 @@ nf_flow_offload_ipv6_hook(void *priv, struct sk_buff *skb,
 	struct net_device *outdev;
 	struct ipv6hdr *ip6h;
 	struct rt6_info *rt;
+	u32 offset = 0;
+	unsigned int mtu;
 
-	if (skb->protocol != htons(ETH_P_IPV6))
+	if (skb->protocol != htons(ETH_P_IPV6) &&
+	    !nf_flow_skb_encap_protocol(skb, htons(ETH_P_IPV6), &offset))
 		return NF_ACCEPT;
 
-	if (nf_flow_tuple_ipv6(skb, state->in, &tuple) < 0)
+	if (nf_flow_tuple_ipv6(skb, state->in, &tuple, offset) < 0)
 		return NF_ACCEPT;
 
 	tuplehash = flow_offload_lookup(flow_table, &tuple);
@@ -502,11 +704,13 @@ nf_flow_offload_ipv6_hook(void *priv, struct sk_buff *skb,
 	rt = (struct rt6_info *)flow->tuplehash[dir].tuple.dst_cache;
 	outdev = rt->dst.dev;
 
-	if (unlikely(nf_flow_exceeds_mtu(skb, flow->tuplehash[dir].tuple.mtu)))
+	mtu = flow->tuplehash[dir].tuple.mtu + offset;
+	if (unlikely(nf_flow_exceeds_mtu(skb, mtu)))
 		return NF_ACCEPT;
 
-	if (nf_flow_state_check(flow, ipv6_hdr(skb)->nexthdr, skb,
-				sizeof(*ip6h)))
+	ip6h = (struct ipv6hdr *)(skb_network_header(skb) + offset);
+	if (nf_flow_state_check(flow, ip6h->nexthdr, skb,
+				sizeof(*ip6h) + offset))
 		return NF_ACCEPT;
 
 	flow_offload_refresh(flow_table, flow);
@@ -516,9 +720,11 @@ nf_flow_offload_ipv6_hook(void *priv, struct sk_buff *skb,
 		return NF_ACCEPT;
 	}
 
-	if (skb_try_make_writable(skb, sizeof(*ip6h)))
+	if (skb_try_make_writable(skb, sizeof(*ip6h) + offset))
 		return NF_DROP;
 
+	nf_flow_encap_pop(skb, &tuplehash->tuple);
+
 	if (nf_flow_nat_ipv6(flow, skb, dir) < 0)
 		return NF_DROP;
 
@@ -536,6 +742,9 @@ nf_flow_offload_ipv6_hook(void *priv, struct sk_buff *skb,
 		return nf_flow_xmit_xfrm(skb, state, &rt->dst);
 	}
 
+	if (nf_flow_xmit_direct_ok(flow, dir, skb))
+		return nf_flow_xmit_direct(state->net, skb, flow, dir);
+
 	skb->dev = outdev;
 	nexthop = rt6_nexthop(rt, &flow->tuplehash[!dir].tuple.src_v6);
 	skb_dst_set_noref(skb, &rt->dst);
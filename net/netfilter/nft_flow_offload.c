@@ -4,11 +4,14 @@
 #include <linux/init.h>
 #include <linux/netlink.h>
 #include <linux/netfilter.h>
+#include <linux/etherdevice.h>
+#include <linux/if_arp.h>
 #include <linux/workqueue.h>
 #include <linux/spinlock.h>
 #include <linux/netfilter/nf_conntrack_common.h>
 #include <linux/netfilter/nf_tables.h>
 #include <net/ip.h> /* for ipv4 options. */
+#include <net/neighbour.h>
 #include <net/netfilter/nf_tables.h>
 #include <net/netfilter/nf_tables_core.h>
 #include <net/netfilter/nf_conntrack_core.h>
@@ -19,10 +22,168 @@ struct nft_flow_offload {
 	struct nft_flowtable	*flowtable;
 };
 
+static bool nft_is_valid_ether_device(const struct net_device *dev)
+{
+	if (!dev || (dev->flags & IFF_LOOPBACK) || dev->type != ARPHRD_ETHER ||
+	    dev->addr_len != ETH_ALEN || !is_valid_ether_addr(dev->dev_addr))
+		return false;
+
+	return true;
+}
+
+static int nft_dev_fill_forward_path(const struct dst_entry *dst,
+				     const struct nf_conn *ct,
+				     enum ip_conntrack_dir dir, u8 *ha,
+				     struct net_device_path_stack *stack)
+{
+	const void *daddr = &ct->tuplehash[!dir].tuple.src.u3;
+	struct net_device *dev = dst->dev;
+	struct neighbour *n;
+	u8 nud_state;
+
+	eth_zero_addr(ha);
+
+	/* PPP devices have no neighbours, the PPPoE hop sets the address */
+	if (!nft_is_valid_ether_device(dev))
+		goto out;
+
+	n = dst_neigh_lookup(dst, daddr);
+	if (!n)
+		return -1;
+
+	read_lock_bh(&n->lock);
+	nud_state = n->nud_state;
+	ether_addr_copy(ha, n->ha);
+	read_unlock_bh(&n->lock);
+	neigh_release(n);
+
+	if (!(nud_state & NUD_VALID))
+		return -1;
+
+out:
+	return dev_fill_forward_path(dev, ha, stack);
+}
+
+struct nft_forward_info {
+	const struct net_device *indev;
+	struct {
+		u16	id;
+		__be16	proto;
+	} encap[NF_FLOW_TABLE_ENCAP_MAX];
+	u8 num_encaps;
+	u8 h_source[ETH_ALEN];
+	u8 h_dest[ETH_ALEN];
+	enum flow_offload_xmit_type xmit_type;
+};
+
+static void nft_dev_path_info(const struct net_device_path_stack *stack,
+			      struct nft_forward_info *info,
+			      const u8 *ha)
+{
+	const struct net_device_path *path;
+	int i;
+
+	memcpy(info->h_dest, ha, ETH_ALEN);
+
+	for (i = 0; i < stack->num_paths; i++) {
+		path = &stack->path[i];
+
+		/* Frames leave with the address of the topmost Ethernet
+		 * device, e.g. the bridge or the VLAN device.
+		 */
+		if (is_zero_ether_addr(info->h_source) &&
+		    nft_is_valid_ether_device(path->dev))
+			memcpy(info->h_source, path->dev->dev_addr, ETH_ALEN);
+
+		switch (path->type) {
+		case DEV_PATH_ETHERNET:
+			info->indev = path->dev;
+			break;
+		case DEV_PATH_VLAN:
+		case DEV_PATH_PPPOE:
+			if (info->num_encaps >= NF_FLOW_TABLE_ENCAP_MAX)
+				return;
+
+			info->encap[info->num_encaps].id = path->encap.id;
+			info->encap[info->num_encaps].proto = path->encap.proto;
+			info->num_encaps++;
+			if (path->type == DEV_PATH_PPPOE)
+				memcpy(info->h_dest, path->encap.h_dest, ETH_ALEN);
+			info->xmit_type = FLOW_OFFLOAD_XMIT_DIRECT;
+			break;
+		case DEV_PATH_BRIDGE:
+			info->xmit_type = FLOW_OFFLOAD_XMIT_DIRECT;
+			break;
+		default:
+			return;
+		}
+	}
+}
+
+static bool nft_flowtable_find_dev(const struct net_device *dev,
+				   struct nft_flowtable *ft)
+{
+	struct nft_hook *hook;
+
+	list_for_each_entry_rcu(hook, &ft->hook_list, list) {
+		if (hook->ops.dev == dev)
+			return true;
+	}
+
+	return false;
+}
+
+/* Resolve the layer 2 path packets in @dir are sent on: if the lower device
+ * is part of the flowtable, packets in the opposite direction are looked up
+ * directly on its ingress hook, with their VLAN and PPPoE encapsulation, and
+ * packets in @dir can be sent there without going through stacked devices.
+ */
+static void nft_dev_forward_path(struct nf_flow_route *route,
+				 const struct nf_conn *ct,
+				 enum ip_conntrack_dir dir,
+				 struct nft_flowtable *ft)
+{
+	const struct dst_entry *dst = route->tuple[dir].dst;
+	struct net_device_path_stack stack;
+	struct nft_forward_info info = {};
+	u8 ha[ETH_ALEN];
+	int i;
+
+	if (dst_xfrm(dst))
+		return;
+
+	if (nft_dev_fill_forward_path(dst, ct, dir, ha, &stack) < 0)
+		return;
+
+	nft_dev_path_info(&stack, &info, ha);
+	if (!info.indev || !nft_flowtable_find_dev(info.indev, ft))
+		return;
+
+	route->tuple[!dir].in.ifindex = info.indev->ifindex;
+	for (i = 0; i < info.num_encaps; i++) {
+		int j = info.num_encaps - i - 1;
+
+		route->tuple[!dir].in.encap[i].id = info.encap[j].id;
+		route->tuple[!dir].in.encap[i].proto = info.encap[j].proto;
+	}
+	route->tuple[!dir].in.num_encaps = info.num_encaps;
+
+	if (info.xmit_type != FLOW_OFFLOAD_XMIT_DIRECT ||
+	    is_zero_ether_addr(info.h_source) ||
+	    is_zero_ether_addr(info.h_dest))
+		return;
+
+	route->tuple[dir].out.ifindex = info.indev->ifindex;
+	memcpy(route->tuple[dir].out.h_source, info.h_source, ETH_ALEN);
+	memcpy(route->tuple[dir].out.h_dest, info.h_dest, ETH_ALEN);
+	route->tuple[dir].xmit_type = FLOW_OFFLOAD_XMIT_DIRECT;
+}
+
 static int nft_flow_route(const struct nft_pktinfo *pkt,
 			  const struct nf_conn *ct,
 			  struct nf_flow_route *route,
-			  enum ip_conntrack_dir dir)
+			  enum ip_conntrack_dir dir,
+			  struct nft_flowtable *ft)
 {
 	struct dst_entry *this_dst = skb_dst(pkt->skb);
 	struct dst_entry *other_dst = NULL;
@@ -47,6 +208,15 @@ static int nft_flow_route(const struct nft_pktinfo *pkt,
 	route->tuple[dir].dst		= this_dst;
 	route->tuple[!dir].dst		= other_dst;
 
+	route->tuple[dir].in.ifindex	= other_dst->dev->ifindex;
+	route->tuple[!dir].in.ifindex	= this_dst->dev->ifindex;
+
+	/* Hardware offload rules are derived from the routes only */
+	if (!nf_flowtable_hw_offload(&ft->data)) {
+		nft_dev_forward_path(route, ct, dir, ft);
+		nft_dev_forward_path(route, ct, !dir, ft);
+	}
+
 	return 0;
 }
 
@@ -75,7 +245,7 @@ static void nft_flow_offload_eval(const struct nft_expr *expr,
 	struct nf_flowtable *flowtable = &priv->flowtable->data;
 	struct tcphdr _tcph, *tcph = NULL;
 	enum ip_conntrack_info ctinfo;
-	struct nf_flow_route route;
+	struct nf_flow_route route = {};
 	struct flow_offload *flow;
 	enum ip_conntrack_dir dir;
 	struct nf_conn *ct;
@@ -112,7 +282,7 @@ static void nft_flow_offload_eval(const struct nft_expr *expr,
 		goto out;
 
 	dir = CTINFO2DIR(ctinfo);
-	if (nft_flow_route(pkt, ct, &route, dir) < 0)
+	if (nft_flow_route(pkt, ct, &route, dir, priv->flowtable) < 0)
 		goto err_flow_route;
 
 	flow = flow_offload_alloc(ct);
@@ -68,7 +68,8 @@
 /* Definitions for vectorised implementations */
 #ifdef NFT_PIPAPO_ALIGN
 #define NFT_PIPAPO_ALIGN_HEADROOM					\
-	(NFT_PIPAPO_ALIGN - ARCH_KMALLOC_MINALIGN)
+	(NFT_PIPAPO_ALIGN > ARCH_KMALLOC_MINALIGN ?			\
+	 NFT_PIPAPO_ALIGN - ARCH_KMALLOC_MINALIGN : 0)
 #define NFT_PIPAPO_LT_ALIGN(lt)		(PTR_ALIGN((lt), NFT_PIPAPO_ALIGN))
 #define NFT_PIPAPO_LT_ASSIGN(field, x)					\
 	do {								\
@@ -130,6 +131,24 @@ struct nft_pipapo_field {
 	union nft_pipapo_map_bucket *mt;
 };
 
+/**
+ * struct nft_pipapo_scratch - Per-CPU data used for lookup and matching
+ * @map_index:	Current working bitmap index, toggled between field matches
+ * @map:	Two bitmaps for partial matching results, selected by @map_index
+ *
+ * The index is shared by the generic and vectorised lookup functions, which
+ * can alternate on the same CPU, as they all rely on the bitmap that isn't
+ * the current one being clean.
+ */
+struct nft_pipapo_scratch {
+	u8 map_index;
+#ifdef NFT_PIPAPO_ALIGN
+	unsigned long map[] __aligned(NFT_PIPAPO_ALIGN);
+#else
+	unsigned long map[];
+#endif
+};
+
 /**
  * struct nft_pipapo_match - Data used for lookup and matching
  * @field_count		Amount of fields in set
@@ -141,9 +160,7 @@ struct nft_pipapo_field {
  */
 struct nft_pipapo_match {
 	int field_count;
-#ifdef NFT_PIPAPO_ALIGN
-	unsigned long * __percpu *scratch_aligned;
-#endif
+	struct nft_pipapo_scratch * __percpu *scratch_aligned;
 	unsigned long * __percpu *scratch;
 	size_t bsize_max;
 	struct rcu_head rcu;
@@ -178,6 +195,8 @@ struct nft_pipapo_elem {
 
 int pipapo_refill(unsigned long *map, int len, int rules, unsigned long *dst,
 		  union nft_pipapo_map_bucket *mt, bool match_only);
+bool nft_pipapo_lookup(const struct net *net, const struct nft_set *set,
+		       const u32 *key, const struct nft_set_ext **ext);
 
 /**
  * pipapo_and_field_buckets_4bit() - Intersect 4-bit buckets
@@ -0,0 +1,21 @@
+/* SPDX-License-Identifier: GPL-2.0-only */
+#ifndef _NFT_SET_PIPAPO_NEON_H
+#define _NFT_SET_PIPAPO_NEON_H
+
+#if defined(CONFIG_ARM64) && defined(CONFIG_KERNEL_MODE_NEON)
+/* Buckets and scratch maps are processed in 128-bit NEON quadwords */
+#define NFT_PIPAPO_NEON_BITS	128
+#define NFT_PIPAPO_ALIGN	(NFT_PIPAPO_NEON_BITS / BITS_PER_BYTE)
+
+struct nft_pipapo_field;
+
+bool nft_pipapo_neon_lookup(const struct net *net, const struct nft_set *set,
+			    const u32 *key, const struct nft_set_ext **ext);
+bool nft_pipapo_neon_estimate(const struct nft_set_desc *desc, u32 features,
+			      struct nft_set_estimate *est);
+int nft_pipapo_neon_match(unsigned long *map, unsigned long *fill,
+			  struct nft_pipapo_field *f, int offset,
+			  const u8 *pkt, bool first, bool last);
+#endif /* defined(CONFIG_ARM64) && defined(CONFIG_KERNEL_MODE_NEON) */
+
+#endif /* _NFT_SET_PIPAPO_NEON_H */
@@ -0,0 +1,234 @@
+// SPDX-License-Identifier: GPL-2.0-only
+
+/* PIPAPO: PIle PAcket POlicies: NEON bucket matching routines
+ *
+ * This file is built with FP/SIMD registers available to the compiler: the
+ * functions here must only be called between kernel_neon_begin() and
+ * kernel_neon_end(), see nft_pipapo_neon_lookup().
+ */
+
+#include <linux/kernel.h>
+#include <linux/netlink.h>
+#include <linux/netfilter.h>
+#include <linux/netfilter/nf_tables.h>
+#include <net/netfilter/nf_tables_core.h>
+#include <uapi/linux/netfilter/nf_tables.h>
+#include <linux/bitmap.h>
+#include <linux/bitops.h>
+
+#include <asm/neon-intrinsics.h>
+
+#include "nft_set_pipapo_neon.h"
+#include "nft_set_pipapo.h"
+
+#define NFT_PIPAPO_LONGS_PER_M128	(NFT_PIPAPO_NEON_BITS / BITS_PER_LONG)
+
+/* Largest amount of bit groups in a field, with 4-bit groups */
+#define NFT_PIPAPO_NEON_GROUPS_MAX	(NFT_PIPAPO_MAX_BYTES * 2)
+
+/**
+ * nft_pipapo_neon_refill() - Scan bitmap, select mapping table item, set bits
+ * @offset:	Start from given bitmap (equivalent to bucket) offset, in longs
+ * @map:	Bitmap to be scanned for set bits
+ * @dst:	Destination bitmap
+ * @mt:		Mapping table containing bit set specifiers
+ * @last:	Return index of first set bit, if this is the last field
+ *
+ * Same as nft_pipapo_avx2_refill(), for the two words covered by a NEON
+ * quadword. This function doesn't use any NEON instruction.
+ *
+ * Return: first set bit index if @last, index of first filled word otherwise.
+ */
+static int nft_pipapo_neon_refill(int offset, unsigned long *map,
+				  unsigned long *dst,
+				  union nft_pipapo_map_bucket *mt, bool last)
+{
+	int ret = -1, x;
+
+	for (x = 0; x < NFT_PIPAPO_LONGS_PER_M128; x++) {
+		while (map[x]) {
+			int r = __builtin_ctzl(map[x]);
+			int i = (offset + x) * BITS_PER_LONG + r;
+
+			if (last)
+				return i;
+
+			bitmap_set(dst, mt[i].to, mt[i].n);
+
+			if (ret == -1)
+				ret = mt[i].to;
+
+			map[x] &= ~(1UL << r);
+		}
+	}
+
+	return ret;
+}
+
+/**
+ * nft_pipapo_neon_match_groups() - NEON-based matching of a single field
+ * @map:	Previous match result, used as initial bitmap
+ * @fill:	Destination bitmap to be filled with current match result
+ * @f:		Field, containing lookup and mapping tables
+ * @offset:	Ignore buckets before the given index, no bits are filled there
+ * @pkt:	Packet data, pointer to input nftables register
+ * @first:	If this is the first field, don't source previous result
+ * @last:	Last field: stop at the first match and return bit index
+ * @bb:		Number of bits grouped together in lookup table buckets
+ * @groups:	Amount of bit groups in the field
+ *
+ * Select the lookup table bucket for each group of packet bits once, then, for
+ * each 128-bit slice of the buckets, intersect the slices of all the selected
+ * buckets, together with the previous result unless this is the first field.
+ * Call nft_pipapo_neon_refill() on non-empty results to generate the next
+ * working bitmap, @fill, and clear slices without matches.
+ *
+ * Two accumulators are used for the intersection, so that loads and ANDs for
+ * odd and even groups don't depend on each other. As this is always inlined
+ * with constant @bb and @groups by nft_pipapo_neon_match(), the compiler can
+ * unroll the inner loop for the common field sizes.
+ *
+ * Return: -1 on no match, rule index of match if @last, otherwise first
+ * quadword index to be checked next (i.e. first filled quadword).
+ */
+static __always_inline int
+nft_pipapo_neon_match_groups(unsigned long *map, unsigned long *fill,
+			     struct nft_pipapo_field *f, int offset,
+			     const u8 *pkt, bool first, bool last,
+			     int bb, int groups)
+{
+	const unsigned long *bucket[NFT_PIPAPO_NEON_GROUPS_MAX];
+	unsigned long *lt = NFT_PIPAPO_LT_ALIGN(f->lt), bsize = f->bsize;
+	int i, g, ret = -1, m128_size = bsize / NFT_PIPAPO_LONGS_PER_M128, b;
+	const uint64x2_t ones = vdupq_n_u64(~0ULL);
+
+	for (g = 0; g < groups; g++) {
+		u8 v;
+
+		if (bb == 8)
+			v = pkt[g];
+		else if (g % 2)
+			v = pkt[g / 2] & 0x0f;
+		else
+			v = pkt[g / 2] >> 4;
+
+		bucket[g] = lt + (g * NFT_PIPAPO_BUCKETS(bb) + v) * bsize;
+	}
+
+	for (i = offset; i < m128_size; i++) {
+		int i_ul = i * NFT_PIPAPO_LONGS_PER_M128;
+		uint64x2_t r0, r1 = ones;
+
+		if (first) {
+			r0 = ones;
+		} else {
+			r0 = vld1q_u64((const u64 *)&map[i_ul]);
+			if (!vmaxvq_u32(vreinterpretq_u32_u64(r0)))
+				continue;
+		}
+
+		for (g = 0; g < groups; g += 2) {
+			r0 = vandq_u64(r0, vld1q_u64((const u64 *)
+						     &bucket[g][i_ul]));
+			if (g + 1 < groups)
+				r1 = vandq_u64(r1, vld1q_u64((const u64 *)
+							     &bucket[g + 1][i_ul]));
+		}
+		r0 = vandq_u64(r0, r1);
+
+		vst1q_u64((u64 *)&map[i_ul], r0);
+		if (!vmaxvq_u32(vreinterpretq_u32_u64(r0)))
+			continue;
+
+		b = nft_pipapo_neon_refill(i_ul, &map[i_ul], fill, f->mt, last);
+		if (last)
+			return b;
+
+		if (unlikely(ret == -1))
+			ret = b / NFT_PIPAPO_NEON_BITS;
+	}
+
+	return ret;
+}
+
+/**
+ * nft_pipapo_neon_match_slow() - Generic NEON matching for uncommon fields
+ * @map:	Previous match result, used as initial bitmap
+ * @fill:	Destination bitmap to be filled with current match result
+ * @f:		Field, containing lookup and mapping tables
+ * @offset:	Ignore buckets before the given index, no bits are filled there
+ * @pkt:	Packet data, pointer to input nftables register
+ * @first:	If this is the first field, don't source previous result
+ * @last:	Last field: stop at the first match and return bit index
+ *
+ * Return: -1 on no match, rule index of match if @last, otherwise first
+ * quadword index to be checked next (i.e. first filled quadword).
+ */
+static noinline int nft_pipapo_neon_match_slow(unsigned long *map,
+					       unsigned long *fill,
+					       struct nft_pipapo_field *f,
+					       int offset, const u8 *pkt,
+					       bool first, bool last)
+{
+	return nft_pipapo_neon_match_groups(map, fill, f, offset, pkt,
+					    first, last, f->bb, f->groups);
+}
+
+/**
+ * nft_pipapo_neon_match() - Match one field using NEON instructions
+ * @map:	Previous match result, used as initial bitmap
+ * @fill:	Destination bitmap to be filled with current match result
+ * @f:		Field, containing lookup and mapping tables
+ * @offset:	Ignore buckets before the given index, no bits are filled there
+ * @pkt:	Packet data, pointer to input nftables register
+ * @first:	If this is the first field, don't source previous result
+ * @last:	Last field: stop at the first match and return bit index
+ *
+ * Dispatch to a version of nft_pipapo_neon_match_groups() specialised for the
+ * field size, for the same field sizes nft_pipapo_avx2_lookup() handles.
+ *
+ * Return: -1 on no match, rule index of match if @last, otherwise first
+ * quadword index to be checked next (i.e. first filled quadword).
+ */
+int nft_pipapo_neon_match(unsigned long *map, unsigned long *fill,
+			  struct nft_pipapo_field *f, int offset,
+			  const u8 *pkt, bool first, bool last)
+{
+#define NFT_PIPAPO_NEON_MATCH(b, n)					\
+	nft_pipapo_neon_match_groups(map, fill, f, offset, pkt,		\
+				     first, last, b, n)
+
+	if (likely(f->bb == 8)) {
+		switch (f->groups) {
+		case 1:
+			return NFT_PIPAPO_NEON_MATCH(8, 1);
+		case 2:
+			return NFT_PIPAPO_NEON_MATCH(8, 2);
+		case 4:
+			return NFT_PIPAPO_NEON_MATCH(8, 4);
+		case 6:
+			return NFT_PIPAPO_NEON_MATCH(8, 6);
+		case 16:
+			return NFT_PIPAPO_NEON_MATCH(8, 16);
+		}
+	} else {
+		switch (f->groups) {
+		case 2:
+			return NFT_PIPAPO_NEON_MATCH(4, 2);
+		case 4:
+			return NFT_PIPAPO_NEON_MATCH(4, 4);
+		case 8:
+			return NFT_PIPAPO_NEON_MATCH(4, 8);
+		case 12:
+			return NFT_PIPAPO_NEON_MATCH(4, 12);
+		case 32:
+			return NFT_PIPAPO_NEON_MATCH(4, 32);
+		}
+	}
+	NFT_PIPAPO_GROUP_BITS_ARE_8_OR_4;
+
+#undef NFT_PIPAPO_NEON_MATCH
+
+	return nft_pipapo_neon_match_slow(map, fill, f, offset, pkt,
+					  first, last);
+}
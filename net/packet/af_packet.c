@@ -494,6 +494,20 @@ static void *packet_current_frame(struct packet_sock *po,
 	return packet_lookup_frame(po, rb, rb->head, status);
 }
 
+static void *packet_current_tx_block(struct packet_ring_buffer *rb,
+				     int status)
+{
+	struct tpacket_block_desc *pbd;
+
+	pbd = (struct tpacket_block_desc *)rb->pg_vec[rb->head].buffer;
+
+	smp_rmb();
+	flush_dcache_page(pgv_to_page(&BLOCK_STATUS(pbd)));
+	if (status != BLOCK_STATUS(pbd))
+		return NULL;
+	return pbd;
+}
+
 static void prb_del_retire_blk_timer(struct tpacket_kbdq_core *pkc)
 {
 	del_timer_sync(&pkc->retire_blk_timer);
@@ -1156,6 +1170,11 @@ static void packet_increment_head(struct packet_ring_buffer *buff)
 	buff->head = buff->head != buff->frame_max ? buff->head+1 : 0;
 }
 
+static void packet_increment_tx_block(struct packet_ring_buffer *buff)
+{
+	buff->head = buff->head != buff->pg_vec_len - 1 ? buff->head + 1 : 0;
+}
+
 static void packet_inc_pending(struct packet_ring_buffer *rb)
 {
 	this_cpu_inc(*rb->pending_refcnt);
@@ -2429,6 +2448,28 @@ static int tpacket_rcv(struct sk_buff *skb, struct net_device *dev,
 	goto drop_n_restore;
 }
 
+/* Drops a reference on a transmit block, and hands the block back to user
+ * space with its final status once the last frame is gone.
+ */
+static void tpacket_tx_blk_put(struct packet_sock *po,
+			       struct tpacket_tx_blk *blk)
+{
+	struct packet_ring_buffer *rb = &po->tx_ring;
+	struct tpacket_block_desc *pbd;
+
+	if (!atomic_dec_and_test(&blk->pending))
+		return;
+
+	pbd = (struct tpacket_block_desc *)rb->pg_vec[blk - rb->tx_blk].buffer;
+	BLOCK_STATUS(pbd) = blk->status;
+	flush_dcache_page(pgv_to_page(&BLOCK_STATUS(pbd)));
+	smp_wmb();
+
+	packet_dec_pending(rb);
+	if (!packet_read_pending(rb))
+		complete(&po->skb_completion);
+}
+
 static void tpacket_destruct_skb(struct sk_buff *skb)
 {
 	struct packet_sock *po = pkt_sk(skb->sk);
@@ -2438,6 +2479,11 @@ static void tpacket_destruct_skb(struct sk_buff *skb)
 		__u32 ts;
 
 		ph = skb_zcopy_get_nouarg(skb);
+		if (po->tx_ring.tx_blk) {
+			tpacket_tx_blk_put(po, ph);
+			goto out;
+		}
+
 		packet_dec_pending(&po->tx_ring);
 
 		ts = __packet_set_timestamp(po, ph, skb);
@@ -2447,6 +2493,7 @@ static void tpacket_destruct_skb(struct sk_buff *skb)
 			complete(&po->skb_completion);
 	}
 
+out:
 	sock_wfree(skb);
 }
 
@@ -2560,7 +2607,7 @@ static int tpacket_fill_skb(struct packet_sock *po, struct sk_buff *skb,
 }
 
 static int tpacket_parse_header(struct packet_sock *po, void *frame,
-				int size_max, void **data)
+				int size_max, int frame_size, void **data)
 {
 	union tpacket_uhdr ph;
 	int tp_len, off;
@@ -2569,7 +2616,7 @@ static int tpacket_parse_header(struct packet_sock *po, void *frame,
 
 	switch (po->tp_version) {
 	case TPACKET_V3:
-		if (ph.h3->tp_next_offset != 0) {
+		if (ph.h3->tp_next_offset != 0 && !po->tx_ring.tx_blk) {
 			pr_warn_once("variable sized slot not supported");
 			return -EINVAL;
 		}
@@ -2591,7 +2638,7 @@ static int tpacket_parse_header(struct packet_sock *po, void *frame,
 		int off_min, off_max;
 
 		off_min = po->tp_hdrlen - sizeof(struct sockaddr_ll);
-		off_max = po->tx_ring.frame_size - tp_len;
+		off_max = frame_size - tp_len;
 		if (po->sk.sk_type == SOCK_DGRAM) {
 			switch (po->tp_version) {
 			case TPACKET_V3:
@@ -2627,6 +2674,195 @@ static int tpacket_parse_header(struct packet_sock *po, void *frame,
 	return tp_len;
 }
 
+/* Returns the first transmit error, dropped frames are already counted in
+ * the device tx_dropped by the xmit path.
+ */
+static int tpacket_xmit_list(struct packet_sock *po, struct sk_buff *skb)
+{
+	struct sk_buff *next;
+	int ret, err = 0;
+
+	if (packet_use_direct_xmit(po)) {
+		ret = dev_direct_xmit_list(skb, packet_pick_tx_queue(skb));
+		return ret > 0 ? net_xmit_errno(ret) : ret;
+	}
+
+	skb_list_walk_safe(skb, skb, next) {
+		skb_mark_not_on_list(skb);
+		ret = po->xmit(skb);
+		if (ret > 0)
+			ret = net_xmit_errno(ret);
+		if (unlikely(ret) && !err)
+			err = ret;
+	}
+
+	return err;
+}
+
+/* Sends the frames of the TPACKET_V3 block at the head of the tx ring, in
+ * one batch, resuming where a previous call stopped if it couldn't allocate
+ * all of them. Frames are chained through tp_next_offset starting from
+ * offset_to_first_pkt, their own tp_status is ignored: the block is handed
+ * back as a whole by tpacket_tx_blk_put().
+ */
+static int tpacket_snd_block(struct packet_sock *po,
+			     struct tpacket_block_desc *pbd,
+			     struct net_device *dev, __be16 proto,
+			     unsigned char *addr,
+			     const struct sockcm_cookie *sockc,
+			     int size_max, int reserve, bool need_wait,
+			     int *len_sum)
+{
+	struct packet_ring_buffer *rb = &po->tx_ring;
+	struct tpacket_tx_blk *blk = &rb->tx_blk[rb->head];
+	int blk_size = rb->pg_vec_pages << PAGE_SHIFT;
+	int hdroff = po->tp_hdrlen - sizeof(struct sockaddr_ll);
+	struct sk_buff *skb, *head = NULL, **tail = &head;
+	int hlen, tlen, tp_len, copylen, len = 0, err = 0;
+	struct virtio_net_hdr *vnet_hdr = NULL;
+	union tpacket_uhdr ph;
+	unsigned int off;
+	void *data;
+
+	if (!blk->next_off) {
+		blk->num_pkts = READ_ONCE(BLOCK_NUM_PKTS(pbd));
+		blk->next_pkt = 0;
+		blk->next_off = READ_ONCE(BLOCK_O2FP(pbd));
+		blk->status = TP_STATUS_AVAILABLE;
+		atomic_set(&blk->pending, 1);
+		packet_inc_pending(rb);
+	}
+
+	hlen = LL_RESERVED_SPACE(dev);
+	tlen = dev->needed_tailroom;
+	while (blk->next_pkt < blk->num_pkts) {
+		off = blk->next_off;
+		if (unlikely(off < BLK_HDR_LEN || off > blk_size - hdroff ||
+			     !IS_ALIGNED(off, TPACKET_ALIGNMENT))) {
+			/* The rest of the chain can't be trusted */
+			blk->status = TP_STATUS_WRONG_FORMAT;
+			err = -EINVAL;
+			break;
+		}
+
+		ph.raw = (char *)pbd + off;
+		tp_len = tpacket_parse_header(po, ph.raw,
+					      min(size_max,
+						  blk_size - (int)off - hdroff),
+					      blk_size - off, &data);
+		if (unlikely(tp_len < 0))
+			goto tpacket_error;
+
+		copylen = 0;
+		if (po->has_vnet_hdr) {
+			vnet_hdr = data;
+			data += sizeof(*vnet_hdr);
+			tp_len -= sizeof(*vnet_hdr);
+			if (tp_len < 0 ||
+			    __packet_snd_vnet_parse(vnet_hdr, tp_len)) {
+				tp_len = -EINVAL;
+				goto tpacket_error;
+			}
+			copylen = __virtio16_to_cpu(vio_le(),
+						    vnet_hdr->hdr_len);
+		}
+		copylen = max_t(int, copylen, dev->hard_header_len);
+		skb = sock_alloc_send_skb(&po->sk,
+				hlen + tlen + sizeof(struct sockaddr_ll) +
+				(copylen - dev->hard_header_len),
+				!need_wait, &err);
+		if (unlikely(!skb))
+			break;
+
+		tp_len = tpacket_fill_skb(po, skb, ph.raw, dev, data, tp_len,
+					  proto, addr, hlen, copylen, sockc);
+		if (likely(tp_len >= 0) &&
+		    tp_len > dev->mtu + reserve &&
+		    !po->has_vnet_hdr &&
+		    !packet_extra_vlan_len_allowed(dev, skb))
+			tp_len = -EMSGSIZE;
+		if (likely(tp_len >= 0) && po->has_vnet_hdr) {
+			if (virtio_net_hdr_to_skb(skb, vnet_hdr, vio_le()))
+				tp_len = -EINVAL;
+			else
+				virtio_net_hdr_set_proto(skb, vnet_hdr);
+		}
+		if (unlikely(tp_len < 0)) {
+			kfree_skb(skb);
+tpacket_error:
+			if (!po->tp_loss) {
+				blk->status = TP_STATUS_WRONG_FORMAT;
+				err = tp_len;
+				break;
+			}
+		} else {
+			skb_zcopy_set_nouarg(skb, blk);
+			skb->destructor = tpacket_destruct_skb;
+			atomic_inc(&blk->pending);
+			*tail = skb;
+			tail = &skb->next;
+			len += tp_len;
+		}
+
+		blk->next_off = off + READ_ONCE(ph.h3->tp_next_offset);
+		blk->next_pkt++;
+	}
+
+	if (head) {
+		/* A batch the device refused isn't reported as sent */
+		int xmit_err = tpacket_xmit_list(po, head);
+
+		if (unlikely(xmit_err))
+			err = xmit_err;
+		else
+			*len_sum += len;
+	}
+
+	if (blk->next_pkt == blk->num_pkts ||
+	    blk->status != TP_STATUS_AVAILABLE) {
+		blk->next_off = 0;
+		packet_increment_tx_block(rb);
+		tpacket_tx_blk_put(po, blk);
+	}
+
+	return err;
+}
+
+static int tpacket_snd_blocks(struct packet_sock *po, struct msghdr *msg,
+			      struct net_device *dev, __be16 proto,
+			      unsigned char *addr,
+			      const struct sockcm_cookie *sockc,
+			      int size_max, int reserve)
+{
+	bool need_wait = !(msg->msg_flags & MSG_DONTWAIT);
+	struct tpacket_block_desc *pbd;
+	int err, len_sum = 0;
+	long timeo;
+
+	do {
+		pbd = packet_current_tx_block(&po->tx_ring,
+					      TP_STATUS_SEND_REQUEST);
+		if (unlikely(!pbd)) {
+			if (need_wait && len_sum) {
+				timeo = sock_sndtimeo(&po->sk, false);
+				timeo = wait_for_completion_interruptible_timeout(&po->skb_completion, timeo);
+				if (timeo <= 0)
+					return !timeo ? -ETIMEDOUT : -ERESTARTSYS;
+			}
+			/* check for additional blocks */
+			continue;
+		}
+
+		err = tpacket_snd_block(po, pbd, dev, proto, addr, sockc,
+					size_max, reserve, need_wait, &len_sum);
+		if (unlikely(err))
+			return len_sum ? : err;
+	} while (likely(pbd != NULL ||
+			(need_wait && packet_read_pending(&po->tx_ring))));
+
+	return len_sum;
+}
+
 static int tpacket_snd(struct packet_sock *po, struct msghdr *msg)
 {
 	struct sk_buff *skb = NULL;
@@ -2700,6 +2936,12 @@ static int tpacket_snd(struct packet_sock *po, struct msghdr *msg)
 
 	reinit_completion(&po->skb_completion);
 
+	if (po->tx_ring.tx_blk) {
+		err = tpacket_snd_blocks(po, msg, dev, proto, addr, &sockc,
+					 size_max, reserve);
+		goto out_put;
+	}
+
 	do {
 		ph = packet_current_frame(po, &po->tx_ring,
 					  TP_STATUS_SEND_REQUEST);
@@ -2717,7 +2959,8 @@ static int tpacket_snd(struct packet_sock *po, struct msghdr *msg)
 		}
 
 		skb = NULL;
-		tp_len = tpacket_parse_header(po, ph, size_max, &data);
+		tp_len = tpacket_parse_header(po, ph, size_max,
+					      po->tx_ring.frame_size, &data);
 		if (tp_len < 0)
 			goto tpacket_error;
 
@@ -4167,7 +4410,9 @@ static __poll_t packet_poll(struct file *file, struct socket *sock,
 	spin_unlock_bh(&sk->sk_receive_queue.lock);
 	spin_lock_bh(&sk->sk_write_queue.lock);
 	if (po->tx_ring.pg_vec) {
-		if (packet_current_frame(po, &po->tx_ring, TP_STATUS_AVAILABLE))
+		if (po->tx_ring.tx_blk ?
+		    packet_current_tx_block(&po->tx_ring, TP_STATUS_AVAILABLE) :
+		    packet_current_frame(po, &po->tx_ring, TP_STATUS_AVAILABLE))
 			mask |= EPOLLOUT | EPOLLWRNORM;
 	}
 	spin_unlock_bh(&sk->sk_write_queue.lock);
@@ -4278,6 +4523,7 @@ static int packet_set_ring(struct sock *sk, union tpacket_req_u *req_u,
 	struct pgv *pg_vec = NULL;
 	struct packet_sock *po = pkt_sk(sk);
 	unsigned long *rx_owner_map = NULL;
+	struct tpacket_tx_blk *tx_blk = NULL;
 	int was_running, order = 0;
 	struct packet_ring_buffer *rb;
 	struct sk_buff_head *rb_queue;
@@ -4348,7 +4594,6 @@ static int packet_set_ring(struct sock *sk, union tpacket_req_u *req_u,
 			goto out;
 		switch (po->tp_version) {
 		case TPACKET_V3:
-			/* Block transmit is not supported yet */
 			if (!tx_ring) {
 				init_prb_bdqc(po, rb, pg_vec, req_u);
 			} else {
@@ -4356,10 +4601,19 @@ static int packet_set_ring(struct sock *sk, union tpacket_req_u *req_u,
 
 				if (req3->tp_retire_blk_tov ||
 				    req3->tp_sizeof_priv ||
-				    req3->tp_feature_req_word) {
+				    (req3->tp_feature_req_word &
+				     ~TP_FT_REQ_TX_BLOCK)) {
 					err = -EINVAL;
 					goto out_free_pg_vec;
 				}
+				if (req3->tp_feature_req_word &
+				    TP_FT_REQ_TX_BLOCK) {
+					tx_blk = kcalloc(req->tp_block_nr,
+							 sizeof(*tx_blk),
+							 GFP_KERNEL);
+					if (!tx_blk)
+						goto out_free_pg_vec;
+				}
 			}
 			break;
 		default:
@@ -4400,6 +4654,8 @@ static int packet_set_ring(struct sock *sk, union tpacket_req_u *req_u,
 		swap(rb->pg_vec, pg_vec);
 		if (po->tp_version <= TPACKET_V2)
 			swap(rb->rx_owner_map, rx_owner_map);
+		else if (tx_ring)
+			swap(rb->tx_blk, tx_blk);
 		rb->frame_max = (req->tp_frame_nr - 1);
 		rb->head = 0;
 		rb->frame_size = req->tp_frame_size;
@@ -4432,6 +4688,7 @@ static int packet_set_ring(struct sock *sk, union tpacket_req_u *req_u,
 
 out_free_pg_vec:
 	bitmap_free(rx_owner_map);
+	kfree(tx_blk);
 	if (pg_vec)
 		free_pg_vec(pg_vec, order, req->tp_block_nr);
 out:
@@ -56,6 +56,17 @@ struct pgv {
 	char *buffer;
 };
 
+/* Kernel side state of a TPACKET_V3 transmit block, the block is handed back
+ * to user space once all its frames are sent and pending drops to zero.
+ */
+struct tpacket_tx_blk {
+	atomic_t	pending;
+	int		status;
+	unsigned int	num_pkts;
+	unsigned int	next_pkt;
+	unsigned int	next_off;
+};
+
 struct packet_ring_buffer {
 	struct pgv		*pg_vec;
 
@@ -73,6 +84,7 @@ struct packet_ring_buffer {
 	union {
 		unsigned long			*rx_owner_map;
 		struct tpacket_kbdq_core	prb_bdqc;
+		struct tpacket_tx_blk		*tx_blk;
 	};
 };
 
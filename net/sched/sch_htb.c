@@ -33,6 +33,8 @@
 #include <linux/rbtree.h>
 #include <linux/workqueue.h>
 #include <linux/slab.h>
+#include <linux/atomic.h>
+#include <linux/spinlock.h>
 #include <net/netlink.h>
 #include <net/sch_generic.h>
 #include <net/pkt_sched.h>
@@ -49,6 +51,19 @@
     Each class is assigned level. Leaf has ALWAYS level 0 and root
     classes have level TC_HTB_MAXDEPTH-1. Interior nodes has level
     one less than their parent.
+
+    Shared mode:
+    An HTB instance can be attached to each TX queue under mq (or mqprio)
+    and join a group of instances on the same device with the "shared"
+    attribute. Each instance then runs under its own queue lock instead of
+    the single root lock. Instances are configured with the same classes,
+    and classes with the same classid share a pair of token buckets kept
+    in atomic variables. The rate and ceil buckets of a class in an
+    instance are no longer refilled with time: they are topped up by taking
+    a batch of tokens from the shared buckets, which are refilled with time
+    by whichever instance gets there first. With XPS, queues and their
+    local buckets are per-CPU. Rates and borrowing hold across instances up
+    to the tokens held locally, at most one batch per class and instance.
 */
 
 static int htb_hysteresis __read_mostly = 0; /* whether to use mode hysteresis for speedup */
@@ -66,6 +81,10 @@ static int htb_rate_est = 0; /* htb classes have a default rate estimator */
 module_param(htb_rate_est, int, 0640);
 MODULE_PARM_DESC(htb_rate_est, "setup a default rate estimator (4sec 16sec) for htb classes");
 
+static unsigned int htb_shared_batch = 16384; /* bytes taken from shared buckets at once */
+module_param(htb_shared_batch, uint, 0640);
+MODULE_PARM_DESC(htb_shared_batch, "bytes worth of tokens moved at once from shared buckets to queues");
+
 /* used internaly to keep status of single class */
 enum htb_cmode {
 	HTB_CANT_SEND,		/* class can't send and can't borrow */
@@ -87,6 +106,31 @@ struct htb_prio {
 	u32		last_ptr_id;
 };
 
+/* token buckets of a class shared among instances in a shared group */
+struct htb_shared_class {
+	struct list_head	list;
+	u32			classid;
+	int			refcnt;
+	s64			buffer, cbuffer;
+
+	/* written by all instances, from their own queue lock */
+	atomic64_t		tokens ____cacheline_aligned_in_smp;
+	atomic64_t		ctokens;
+	atomic64_t		t_c;
+};
+
+/* group of HTB instances on queues of the same device */
+struct htb_shared {
+	struct list_head	list;
+	struct net_device	*dev;
+	u32			id;
+	int			refcnt;
+	struct list_head	classes;
+};
+
+static LIST_HEAD(htb_shared_list);
+static DEFINE_SPINLOCK(htb_shared_lock);	/* protects groups and classes lists */
+
 /* interior & leaf nodes; props specific to leaves are marked L:
  * To reduce false sharing, place mostly read fields at beginning,
  * and mostly written ones at the end.
@@ -110,6 +154,9 @@ struct htb_class {
 
 	struct net_rate_estimator __rcu *rate_est;
 
+	struct htb_shared_class	*shared;	/* shared buckets, if any */
+	s64			batch, cbatch;	/* tokens taken from them */
+
 	/*
 	 * Written often fields
 	 */
@@ -149,6 +196,7 @@ struct htb_sched {
 	struct Qdisc_class_hash clhash;
 	int			defcls;		/* class where unclassified flows go to */
 	int			rate2quantum;	/* quant = rate / rate2quantum */
+	struct htb_shared	*shared;	/* group we share buckets with */
 
 	/* filters for qdisc itself */
 	struct tcf_proto __rcu	*filter_list;
@@ -192,6 +240,79 @@ static unsigned long htb_search(struct Qdisc *sch, u32 handle)
 {
 	return (unsigned long)htb_find(handle, sch);
 }
+
+static void htb_shared_add(atomic64_t *v, s64 toks, s64 max)
+{
+	s64 old = atomic64_read(v), new;
+
+	do {
+		if (old >= max)
+			return;
+		new = min(old + toks, max);
+	} while (!atomic64_try_cmpxchg(v, &old, new));
+}
+
+static s64 htb_shared_take(atomic64_t *v, s64 want)
+{
+	s64 old = atomic64_read(v), grant;
+
+	do {
+		if (old <= 0)
+			return 0;
+		grant = min(old, want);
+	} while (!atomic64_try_cmpxchg(v, &old, old - grant));
+
+	return grant;
+}
+
+/**
+ * htb_shared_fill - tops up local buckets of cl from the shared ones
+ *
+ * Shared buckets are refilled first with the time elapsed since the last
+ * refill, by a single instance: the others see the updated checkpoint and
+ * skip it. Local buckets are then topped up to a batch, if the shared ones
+ * have enough tokens.
+ */
+static void htb_shared_fill(struct htb_class *cl, s64 now)
+{
+	struct htb_shared_class *shc = cl->shared;
+	s64 t_c = atomic64_read(&shc->t_c);
+
+	if (now > t_c && atomic64_cmpxchg(&shc->t_c, t_c, now) == t_c) {
+		htb_shared_add(&shc->tokens, now - t_c, READ_ONCE(shc->buffer));
+		htb_shared_add(&shc->ctokens, now - t_c, READ_ONCE(shc->cbuffer));
+	}
+
+	if (cl->tokens < cl->batch)
+		cl->tokens += htb_shared_take(&shc->tokens,
+					      cl->batch - cl->tokens);
+	if (cl->ctokens < cl->cbatch)
+		cl->ctokens += htb_shared_take(&shc->ctokens,
+					       cl->cbatch - cl->ctokens);
+}
+
+/* returns tokens credited to cl since its checkpoint time */
+static s64 htb_class_credit(struct htb_sched *q, struct htb_class *cl)
+{
+	if (cl->shared) {
+		htb_shared_fill(cl, q->now);
+		return 0;
+	}
+
+	return min_t(s64, q->now - cl->t_c, cl->mbuffer);
+}
+
+/* If shared buckets are drained too, local ones can't recover before the
+ * shared ones are refilled: don't poll them more often than once a batch.
+ */
+static s64 htb_shared_delay(const struct htb_class *cl, s64 delay)
+{
+	if (atomic64_read(&cl->shared->tokens) > 0 &&
+	    atomic64_read(&cl->shared->ctokens) > 0)
+		return delay;
+
+	return max(delay, cl->batch);
+}
 /**
  * htb_classify - classify a packet into class
  *
@@ -302,6 +423,9 @@ static void htb_add_to_wait_tree(struct htb_sched *q,
 {
 	struct rb_node **p = &q->hlevel[cl->level].wait_pq.rb_node, *parent = NULL;
 
+	if (cl->shared)
+		delay = htb_shared_delay(cl, delay);
+
 	cl->pq_key = q->now + delay;
 	if (cl->pq_key == q->now)
 		cl->pq_key++;
@@ -660,7 +784,7 @@ static void htb_charge_class(struct htb_sched *q, struct htb_class *cl,
 	s64 diff;
 
 	while (cl) {
-		diff = min_t(s64, q->now - cl->t_c, cl->mbuffer);
+		diff = htb_class_credit(q, cl);
 		if (cl->level >= level) {
 			if (cl->level == level)
 				cl->xstats.lends++;
@@ -720,7 +844,7 @@ static s64 htb_do_events(struct htb_sched *q, const int level,
 			return cl->pq_key;
 
 		htb_safe_rb_erase(p, wait_pq);
-		diff = min_t(s64, q->now - cl->t_c, cl->mbuffer);
+		diff = htb_class_credit(q, cl);
 		htb_change_class_mode(q, cl, &diff);
 		if (cl->cmode != HTB_CAN_SEND)
 			htb_add_to_wait_tree(q, cl, diff);
@@ -980,8 +1104,96 @@ static const struct nla_policy htb_policy[TCA_HTB_MAX + 1] = {
 	[TCA_HTB_DIRECT_QLEN] = { .type = NLA_U32 },
 	[TCA_HTB_RATE64] = { .type = NLA_U64 },
 	[TCA_HTB_CEIL64] = { .type = NLA_U64 },
+	[TCA_HTB_SHARED] = { .type = NLA_U32 },
 };
 
+static struct htb_shared *htb_shared_get(struct net_device *dev, u32 id)
+{
+	struct htb_shared *sh, *new;
+
+	new = kzalloc(sizeof(*new), GFP_KERNEL);
+	if (!new)
+		return NULL;
+
+	spin_lock(&htb_shared_lock);
+	list_for_each_entry(sh, &htb_shared_list, list) {
+		if (sh->dev == dev && sh->id == id) {
+			sh->refcnt++;
+			spin_unlock(&htb_shared_lock);
+			kfree(new);
+			return sh;
+		}
+	}
+	new->dev = dev;
+	new->id = id;
+	new->refcnt = 1;
+	INIT_LIST_HEAD(&new->classes);
+	list_add(&new->list, &htb_shared_list);
+	spin_unlock(&htb_shared_lock);
+
+	return new;
+}
+
+static void htb_shared_put(struct htb_shared *sh)
+{
+	spin_lock(&htb_shared_lock);
+	if (--sh->refcnt) {
+		spin_unlock(&htb_shared_lock);
+		return;
+	}
+	list_del(&sh->list);
+	spin_unlock(&htb_shared_lock);
+
+	WARN_ON(!list_empty(&sh->classes));
+	kfree(sh);
+}
+
+static struct htb_shared_class *htb_shared_class_get(struct htb_shared *sh,
+						     u32 classid, s64 buffer,
+						     s64 cbuffer)
+{
+	struct htb_shared_class *shc, *new;
+
+	new = kzalloc(sizeof(*new), GFP_KERNEL);
+	if (!new)
+		return NULL;
+
+	spin_lock(&htb_shared_lock);
+	list_for_each_entry(shc, &sh->classes, list) {
+		if (shc->classid == classid) {
+			shc->refcnt++;
+			spin_unlock(&htb_shared_lock);
+			kfree(new);
+			return shc;
+		}
+	}
+	new->classid = classid;
+	new->refcnt = 1;
+	new->buffer = buffer;
+	new->cbuffer = cbuffer;
+	atomic64_set(&new->tokens, buffer);
+	atomic64_set(&new->ctokens, cbuffer);
+	atomic64_set(&new->t_c, ktime_get_ns());
+	list_add(&new->list, &sh->classes);
+	spin_unlock(&htb_shared_lock);
+
+	return new;
+}
+
+static void htb_shared_class_put(struct htb_shared *sh,
+				 struct htb_shared_class *shc)
+{
+	spin_lock(&htb_shared_lock);
+	if (--shc->refcnt) {
+		spin_unlock(&htb_shared_lock);
+		return;
+	}
+	list_del(&shc->list);
+	spin_unlock(&htb_shared_lock);
+
+	kfree(shc);
+}
+
 static void htb_work_func(struct work_struct *work)
 {
 	struct htb_sched *q = container_of(work, struct htb_sched, work);
@@ -1037,6 +1249,22 @@ static int htb_init(struct Qdisc *sch, struct nlattr *opt,
 		q->rate2quantum = 1;
 	q->defcls = gopt->defcls;
 
+	if (tb[TCA_HTB_SHARED] && nla_get_u32(tb[TCA_HTB_SHARED])) {
+		struct net_device *dev = qdisc_dev(sch);
+		struct Qdisc *parent = NULL;
+
+		if (sch->parent != TC_H_ROOT)
+			parent = qdisc_lookup(dev, TC_H_MAJ(sch->parent));
+		if (!parent || !(parent->flags & TCQ_F_MQROOT)) {
+			NL_SET_ERR_MSG(extack, "Shared HTB must be attached to a queue of a multi-queue root qdisc");
+			return -EOPNOTSUPP;
+		}
+
+		q->shared = htb_shared_get(dev, nla_get_u32(tb[TCA_HTB_SHARED]));
+		if (!q->shared)
+			return -ENOMEM;
+	}
+
 	return 0;
 }
 
@@ -1063,6 +1291,8 @@ static int htb_dump(struct Qdisc *sch, struct sk_buff *skb)
 	if (nla_put(skb, TCA_HTB_INIT, sizeof(gopt), &gopt) ||
 	    nla_put_u32(skb, TCA_HTB_DIRECT_QLEN, q->direct_qlen))
 		goto nla_put_failure;
+	if (q->shared && nla_put_u32(skb, TCA_HTB_SHARED, q->shared->id))
+		goto nla_put_failure;
 
 	return nla_nest_end(skb, nest);
 
@@ -1198,20 +1428,24 @@ static void htb_parent_to_leaf(struct htb_sched *q, struct htb_class *cl,
 	parent->level = 0;
 	memset(&parent->inner, 0, sizeof(parent->inner));
 	parent->leaf.q = new_q ? new_q : &noop_qdisc;
-	parent->tokens = parent->buffer;
-	parent->ctokens = parent->cbuffer;
+	parent->tokens = parent->shared ? 0 : parent->buffer;
+	parent->ctokens = parent->shared ? 0 : parent->cbuffer;
 	parent->t_c = ktime_get_ns();
 	parent->cmode = HTB_CAN_SEND;
 }
 
 static void htb_destroy_class(struct Qdisc *sch, struct htb_class *cl)
 {
+	struct htb_sched *q = qdisc_priv(sch);
+
 	if (!cl->level) {
 		WARN_ON(!cl->leaf.q);
 		qdisc_put(cl->leaf.q);
 	}
 	gen_kill_estimator(&cl->rate_est);
 	tcf_block_put(cl->block);
+	if (cl->shared)
+		htb_shared_class_put(q->shared, cl->shared);
 	kfree(cl);
 }
 
@@ -1244,6 +1478,8 @@ static void htb_destroy(struct Qdisc *sch)
 	}
 	qdisc_class_hash_destroy(&q->clhash);
 	__qdisc_reset_queue(&q->direct_queue);
+	if (q->shared)
+		htb_shared_put(q->shared);
 }
 
 static int htb_delete(struct Qdisc *sch, unsigned long arg)
@@ -1385,6 +1621,18 @@ static int htb_change_class(struct Qdisc *sch, u32 classid,
 				goto failure;
 			}
 		}
+		if (q->shared) {
+			cl->shared = htb_shared_class_get(q->shared, classid,
+							  PSCHED_TICKS2NS(hopt->buffer),
+							  PSCHED_TICKS2NS(hopt->cbuffer));
+			if (!cl->shared) {
+				err = -ENOBUFS;
+				gen_kill_estimator(&cl->rate_est);
+				tcf_block_put(cl->block);
+				kfree(cl);
+				goto failure;
+			}
+		}
 
 		cl->children = 0;
 		RB_CLEAR_NODE(&cl->pq_node);
@@ -1421,9 +1669,11 @@ static int htb_change_class(struct Qdisc *sch, u32 classid,
 		cl->common.classid = classid;
 		cl->parent = parent;
 
-		/* set class to be in HTB_CAN_SEND state */
-		cl->tokens = PSCHED_TICKS2NS(hopt->buffer);
-		cl->ctokens = PSCHED_TICKS2NS(hopt->cbuffer);
+		/* set class to be in HTB_CAN_SEND state; shared classes
+		 * start empty and take tokens from shared buckets instead
+		 */
+		cl->tokens = cl->shared ? 0 : PSCHED_TICKS2NS(hopt->buffer);
+		cl->ctokens = cl->shared ? 0 : PSCHED_TICKS2NS(hopt->cbuffer);
 		cl->mbuffer = 60ULL * NSEC_PER_SEC;	/* 1min */
 		cl->t_c = ktime_get_ns();
 		cl->cmode = HTB_CAN_SEND;
@@ -1480,6 +1730,15 @@ static int htb_change_class(struct Qdisc *sch, u32 classid,
 	cl->buffer = PSCHED_TICKS2NS(hopt->buffer);
 	cl->cbuffer = PSCHED_TICKS2NS(hopt->cbuffer);
 
+	if (cl->shared) {
+		WRITE_ONCE(cl->shared->buffer, cl->buffer);
+		WRITE_ONCE(cl->shared->cbuffer, cl->cbuffer);
+		cl->batch = min_t(s64, psched_l2t_ns(&cl->rate, htb_shared_batch),
+				  cl->buffer);
+		cl->cbatch = min_t(s64, psched_l2t_ns(&cl->ceil, htb_shared_batch),
+				   cl->cbuffer);
+	}
+
 	sch_tree_unlock(sch);
 	qdisc_put(parent_qdisc);
 
@@ -1389,6 +1389,10 @@ static int tls_setup_from_iter(struct sock *sk, struct iov_iter *from,
  * out_iov or out_sg must be non-NULL. In case both out_iov and out_sg are
  * NULL, then the decryption happens inside skb buffers itself, i.e.
  * zero-copy gets disabled and 'zc' is updated.
+ *
+ * For TLS 1.3 records decrypted into out_iov, the last byte of plaintext,
+ * which is the record type unless the record is padded, goes to kernel
+ * memory and is stored in the control field of the skb.
  */
 
 static int decrypt_internal(struct sock *sk, struct sk_buff *skb,
@@ -1403,7 +1407,7 @@ static int decrypt_internal(struct sock *sk, struct sk_buff *skb,
 	int n_sgin, n_sgout, nsg, mem_size, aead_size, err, pages = 0;
 	struct aead_request *aead_req;
 	struct sk_buff *unused;
-	u8 *aad, *iv, *mem = NULL;
+	u8 *aad, *iv, *tail, *mem = NULL;
 	struct scatterlist *sgin = NULL;
 	struct scatterlist *sgout = NULL;
 	const int data_len = rxm->full_len - prot->overhead_size +
@@ -1412,7 +1416,8 @@ static int decrypt_internal(struct sock *sk, struct sk_buff *skb,
 
 	if (*zc && (out_iov || out_sg)) {
 		if (out_iov)
-			n_sgout = iov_iter_npages(out_iov, INT_MAX) + 1;
+			n_sgout = iov_iter_npages(out_iov, INT_MAX) + 1 +
+				  prot->tail_size;
 		else
 			n_sgout = sg_nents(out_sg);
 		n_sgin = skb_nsg(skb, rxm->offset + prot->prepend_size,
@@ -1435,9 +1440,10 @@ static int decrypt_internal(struct sock *sk, struct sk_buff *skb,
 	mem_size = aead_size + (nsg * sizeof(struct scatterlist));
 	mem_size = mem_size + prot->aad_size;
 	mem_size = mem_size + crypto_aead_ivsize(ctx->aead_recv);
+	mem_size = mem_size + prot->tail_size;
 
 	/* Allocate a single block of memory which contains
-	 * aead_req || sgin[] || sgout[] || aad || iv.
+	 * aead_req || sgin[] || sgout[] || aad || iv || tail.
 	 * This order achieves correct alignment for aead_req, sgin, sgout.
 	 */
 	mem = kmalloc(mem_size, sk->sk_allocation);
@@ -1450,6 +1456,7 @@ static int decrypt_internal(struct sock *sk, struct sk_buff *skb,
 	sgout = sgin + n_sgin;
 	aad = (u8 *)(sgout + n_sgout);
 	iv = aad + prot->aad_size;
+	tail = iv + crypto_aead_ivsize(ctx->aead_recv);
 
 	/* For CCM based ciphers, first byte of nonce+iv is always '2' */
 	if (prot->cipher_type == TLS_CIPHER_AES_CCM_128) {
@@ -1496,11 +1503,18 @@ static int decrypt_internal(struct sock *sk, struct sk_buff *skb,
 			sg_set_buf(&sgout[0], aad, prot->aad_size);
 
 			*chunk = 0;
-			err = tls_setup_from_iter(sk, out_iov, data_len,
+			err = tls_setup_from_iter(sk, out_iov,
+						  data_len - prot->tail_size,
 						  &pages, chunk, &sgout[1],
-						  (n_sgout - 1));
+						  (n_sgout - 1 - prot->tail_size));
 			if (err < 0)
 				goto fallback_to_reg_recv;
+			if (prot->tail_size) {
+				sg_unmark_end(&sgout[pages]);
+				sg_set_buf(&sgout[pages + 1], tail,
+					   prot->tail_size);
+				sg_mark_end(&sgout[pages + 1]);
+			}
 		} else if (out_sg) {
 			memcpy(sgout, out_sg, n_sgout * sizeof(*sgout));
 		} else {
@@ -1520,6 +1534,9 @@ static int decrypt_internal(struct sock *sk, struct sk_buff *skb,
 	if (err == -EINPROGRESS)
 		return err;
 
+	if (!err && *zc && out_iov && prot->tail_size)
+		tls_msg(skb)->control = *tail;
+
 	/* Release the pages in case iov was mapped to pages */
 	for (; pages > 0; pages--)
 		put_page(sg_page(&sgout[pages]));
@@ -1547,8 +1564,29 @@ static int decrypt_skb_update(struct sock *sk, struct sk_buff *skb,
 
 		/* Still not decrypted after tls_device */
 		if (!ctx->decrypted) {
+			struct iov_iter saved_dest;
+
+			if (dest)
+				saved_dest = *dest;
 			err = decrypt_internal(sk, skb, dest, NULL, chunk, zc,
 					       async);
+			/* A TLS 1.3 record decrypted into the user buffer turned
+			 * out to be padded or not to carry data, decrypt it
+			 * again in the skb. The ciphertext is left untouched by
+			 * zero-copy decryption.
+			 */
+			if (!err && *zc && prot->version == TLS_1_3_VERSION &&
+			    tls_msg(skb)->control != TLS_RECORD_TYPE_DATA) {
+				if (!tls_msg(skb)->control)
+					TLS_INC_STATS(sock_net(sk),
+						      LINUX_MIB_TLSRXNOPADVIOL);
+				TLS_INC_STATS(sock_net(sk),
+					      LINUX_MIB_TLSDECRYPTRETRY);
+				*dest = saved_dest;
+				*zc = false;
+				err = decrypt_internal(sk, skb, NULL, NULL,
+						       chunk, zc, false);
+			}
 			if (err < 0) {
 				if (err == -EINPROGRESS)
 					tls_advance_record_sn(sk, prot,
@@ -1562,9 +1600,15 @@ static int decrypt_skb_update(struct sock *sk, struct sk_buff *skb,
 			*zc = false;
 		}
 
-		pad = padding_length(ctx, prot, skb);
-		if (pad < 0)
-			return pad;
+		if (*zc && prot->version == TLS_1_3_VERSION) {
+			/* record type came in the last byte */
+			ctx->control = tls_msg(skb)->control;
+			pad = 0;
+		} else {
+			pad = padding_length(ctx, prot, skb);
+			if (pad < 0)
+				return pad;
+		}
 
 		rxm->full_len -= pad;
 		rxm->offset += prot->prepend_size;
@@ -1808,7 +1852,7 @@ int tls_sw_recvmsg(struct sock *sk,
 
 		if (to_decrypt <= len && !is_kvec && !is_peek &&
 		    ctx->control == TLS_RECORD_TYPE_DATA &&
-		    prot->version != TLS_1_3_VERSION &&
+		    (prot->version != TLS_1_3_VERSION || tls_ctx->rx_no_pad) &&
 		    !bpf_strp_enabled)
 			zc = true;
 
@@ -22,6 +22,7 @@
 #include <linux/net.h>
 #include <linux/netdevice.h>
 #include <linux/rculist.h>
+#include <net/busy_poll.h>
 #include <net/xdp_sock_drv.h>
 #include <net/xdp.h>
 
@@ -30,6 +31,8 @@
 #include "xsk.h"
 
 #define TX_BATCH_SIZE 16
+/* One linear part plus one page fragment per continuation descriptor */
+#define XSK_MAX_DESCS_PER_PKT (MAX_SKB_FRAGS + 1)
 
 static DEFINE_PER_CPU(struct list_head, xskmap_flush_list);
 
@@ -121,7 +124,7 @@ static int __xsk_rcv_zc(struct xdp_sock *xs, struct xdp_buff *xdp, u32 len)
 	int err;
 
 	addr = xp_get_handle(xskb);
-	err = xskq_prod_reserve_desc(xs->rx, addr, len);
+	err = xskq_prod_reserve_desc(xs->rx, addr, len, 0);
 	if (err) {
 		xs->rx_queue_full++;
 		return err;
@@ -149,15 +152,70 @@ static void xsk_copy_xdp(struct xdp_buff *to, struct xdp_buff *from, u32 len)
 	memcpy(to_buf, from_buf, len + metalen);
 }
 
+/* Copy a frame larger than one chunk into a chain of descriptors, all but
+ * the last one flagged with XDP_PKT_CONTD.
+ */
+static int __xsk_rcv_sg(struct xdp_sock *xs, struct xdp_buff *xdp, u32 len,
+			u32 frame_size)
+{
+	struct xdp_buff *bufs[XSK_MAX_DESCS_PER_PKT];
+	u32 nb = DIV_ROUND_UP(len, frame_size);
+	u32 i, copied = 0;
+
+	if (nb > XSK_MAX_DESCS_PER_PKT) {
+		xs->rx_dropped++;
+		return -ENOSPC;
+	}
+
+	if (xskq_prod_nb_free(xs->rx, nb) < nb) {
+		xs->rx_queue_full++;
+		return -ENOSPC;
+	}
+
+	for (i = 0; i < nb; i++) {
+		bufs[i] = xsk_buff_alloc(xs->umem);
+		if (!bufs[i]) {
+			while (i--)
+				xsk_buff_free(bufs[i]);
+			xs->rx_dropped++;
+			return -ENOSPC;
+		}
+	}
+
+	xsk_copy_xdp(bufs[0], xdp, frame_size);
+	for (i = 0; i < nb; i++) {
+		struct xdp_buff_xsk *xskb;
+		u32 seg = min(len - copied, frame_size);
+
+		if (i)
+			memcpy(bufs[i]->data, xdp->data + copied, seg);
+		copied += seg;
+
+		xskb = container_of(bufs[i], struct xdp_buff_xsk, xdp);
+		/* Cannot fail, the space was checked above. */
+		xskq_prod_reserve_desc(xs->rx, xp_get_handle(xskb), seg,
+				       i < nb - 1 ? XDP_PKT_CONTD : 0);
+		xp_release(xskb);
+	}
+	return 0;
+}
+
 static int __xsk_rcv(struct xdp_sock *xs, struct xdp_buff *xdp, u32 len,
 		     bool explicit_free)
 {
+	u32 frame_size = xsk_umem_get_rx_frame_size(xs->umem);
 	struct xdp_buff *xsk_xdp;
 	int err;
 
-	if (len > xsk_umem_get_rx_frame_size(xs->umem)) {
-		xs->rx_dropped++;
-		return -ENOSPC;
+	if (len > frame_size) {
+		if (!xs->sg) {
+			xs->rx_dropped++;
+			return -ENOSPC;
+		}
+		err = __xsk_rcv_sg(xs, xdp, len, frame_size);
+		if (!err && explicit_free)
+			xdp_return_buff(xdp);
+		return err;
 	}
 
 	xsk_xdp = xsk_buff_alloc(xs->umem);
@@ -198,6 +256,7 @@ static int xsk_rcv(struct xdp_sock *xs, struct xdp_buff *xdp,
 	if (xs->dev != xdp->rxq->dev || xs->queue_id != xdp->rxq->queue_index)
 		return -EINVAL;
 
+	sk_mark_napi_id_once_xdp(&xs->sk, xdp);
 	len = xdp->data_end - xdp->data;
 
 	return xdp->rxq->mem.type == MEM_TYPE_XSK_BUFF_POOL ?
@@ -317,23 +376,73 @@ static int xsk_zc_xmit(struct xdp_sock *xs)
 
 static void xsk_destruct_skb(struct sk_buff *skb)
 {
-	u64 addr = (u64)(long)skb_shinfo(skb)->destructor_arg;
+	u32 nb_descs = (u32)(long)skb_shinfo(skb)->destructor_arg;
 	struct xdp_sock *xs = xdp_sk(skb->sk);
 	unsigned long flags;
 
+	/* The addresses were written when the completion slots were
+	 * reserved, only publish them here.
+	 */
 	spin_lock_irqsave(&xs->tx_completion_lock, flags);
-	xskq_prod_submit_addr(xs->umem->cq, addr);
+	xskq_prod_submit_n(xs->umem->cq, nb_descs);
 	spin_unlock_irqrestore(&xs->tx_completion_lock, flags);
 
 	sock_wfree(skb);
 }
 
+static struct sk_buff *xsk_build_skb(struct xdp_sock *xs,
+				     struct xdp_desc *descs, u32 nb_descs,
+				     int *err)
+{
+	struct sock *sk = &xs->sk;
+	struct sk_buff *skb;
+	u32 len, i;
+
+	len = descs[0].len;
+	skb = sock_alloc_send_skb(sk, len, 1, err);
+	if (unlikely(!skb))
+		return NULL;
+
+	skb_put(skb, len);
+	*err = skb_store_bits(skb, 0,
+			      xsk_buff_raw_get_data(xs->umem, descs[0].addr),
+			      len);
+	if (unlikely(*err))
+		goto free_skb;
+
+	/* Continuation descriptors are at most a chunk, i.e. a page, long. */
+	for (i = 1; i < nb_descs; i++) {
+		struct page *page = alloc_page(sk->sk_allocation);
+
+		if (unlikely(!page)) {
+			*err = -EAGAIN;
+			goto free_skb;
+		}
+		len = descs[i].len;
+		memcpy(page_address(page),
+		       xsk_buff_raw_get_data(xs->umem, descs[i].addr), len);
+		skb_add_rx_frag(skb, i - 1, page, 0, len, PAGE_SIZE);
+		refcount_add(PAGE_SIZE, &sk->sk_wmem_alloc);
+	}
+
+	skb->dev = xs->dev;
+	skb->priority = sk->sk_priority;
+	skb->mark = sk->sk_mark;
+	skb_shinfo(skb)->destructor_arg = (void *)(long)nb_descs;
+	skb->destructor = xsk_destruct_skb;
+	return skb;
+
+free_skb:
+	kfree_skb(skb);
+	return NULL;
+}
+
 static int xsk_generic_xmit(struct sock *sk)
 {
+	struct xdp_desc descs[XSK_MAX_DESCS_PER_PKT];
 	struct xdp_sock *xs = xdp_sk(sk);
 	u32 max_batch = TX_BATCH_SIZE;
 	bool sent_frame = false;
-	struct xdp_desc desc;
 	struct sk_buff *skb;
 	int err = 0;
 
@@ -342,40 +451,49 @@ static int xsk_generic_xmit(struct sock *sk)
 	if (xs->queue_id >= xs->dev->real_num_tx_queues)
 		goto out;
 
-	while (xskq_cons_peek_desc(xs->tx, &desc, xs->umem)) {
-		char *buffer;
-		u64 addr;
-		u32 len;
+	while (xskq_cons_peek_desc(xs->tx, &descs[0], xs->umem)) {
+		int nb_descs = 1;
+		int i;
 
 		if (max_batch-- == 0) {
 			err = -EAGAIN;
 			goto out;
 		}
 
-		len = desc.len;
-		skb = sock_alloc_send_skb(sk, len, 1, &err);
-		if (unlikely(!skb))
-			goto out;
+		if (descs[0].options & XDP_PKT_CONTD) {
+			if (!xs->sg) {
+				/* Skip the whole packet */
+				xs->tx->invalid_descs++;
+				xs->tx->skip_pkt = true;
+				xskq_cons_release(xs->tx);
+				continue;
+			}
+			nb_descs = xskq_cons_read_pkt(xs->tx, descs,
+						      XSK_MAX_DESCS_PER_PKT,
+						      xs->umem);
+			if (!nb_descs)
+				/* Wait for the rest of the packet */
+				goto out;
+			if (nb_descs < 0) {
+				xskq_cons_release_n(xs->tx, -nb_descs);
+				continue;
+			}
+		}
 
-		skb_put(skb, len);
-		addr = desc.addr;
-		buffer = xsk_buff_raw_get_data(xs->umem, addr);
-		err = skb_store_bits(skb, 0, buffer, len);
 		/* This is the backpressure mechanism for the Tx path.
 		 * Reserve space in the completion queue and only proceed
 		 * if there is space in it. This avoids having to implement
 		 * any buffering in the Tx path.
 		 */
-		if (unlikely(err) || xskq_prod_reserve(xs->umem->cq)) {
-			kfree_skb(skb);
+		if (xskq_prod_nb_free(xs->umem->cq, nb_descs) < nb_descs)
 			goto out;
-		}
 
-		skb->dev = xs->dev;
-		skb->priority = sk->sk_priority;
-		skb->mark = sk->sk_mark;
-		skb_shinfo(skb)->destructor_arg = (void *)(long)desc.addr;
-		skb->destructor = xsk_destruct_skb;
+		skb = xsk_build_skb(xs, descs, nb_descs, &err);
+		if (unlikely(!skb))
+			goto out;
+
+		for (i = 0; i < nb_descs; i++)
+			xskq_prod_reserve_addr(xs->umem->cq, descs[i].addr);
 
 		/* Hinder dev_direct_xmit from freeing the packet and
 		 * therefore completing it in the destructor
@@ -385,13 +503,14 @@ static int xsk_generic_xmit(struct sock *sk)
 		if  (err == NETDEV_TX_BUSY) {
 			/* Tell user-space to retry the send */
 			skb->destructor = sock_wfree;
+			xskq_prod_cancel_n(xs->umem->cq, nb_descs);
 			/* Free skb without triggering the perf drop trace */
 			consume_skb(skb);
 			err = -EAGAIN;
 			goto out;
 		}
 
-		xskq_cons_release(xs->tx);
+		xskq_cons_release_n(xs->tx, nb_descs);
 		/* Ignore NET_XMIT_CN as packet might have been sent */
 		if (err == NET_XMIT_DROP) {
 			/* SKB completed but not sent */
@@ -426,6 +545,17 @@ static int __xsk_sendmsg(struct sock *sk)
 	return xs->zc ? xsk_zc_xmit(xs) : xsk_generic_xmit(sk);
 }
 
+static bool xsk_no_wakeup(struct sock *sk)
+{
+#ifdef CONFIG_NET_RX_BUSY_POLL
+	/* Prefer busy-polling, skip the wakeup. */
+	return READ_ONCE(sk->sk_prefer_busy_poll) && READ_ONCE(sk->sk_ll_usec) &&
+		READ_ONCE(sk->sk_napi_id) >= MIN_NAPI_ID;
+#else
+	return false;
+#endif
+}
+
 static int xsk_sendmsg(struct socket *sock, struct msghdr *m, size_t total_len)
 {
 	bool need_wait = !(m->msg_flags & MSG_DONTWAIT);
@@ -437,9 +567,45 @@ static int xsk_sendmsg(struct socket *sock, struct msghdr *m, size_t total_len)
 	if (unlikely(need_wait))
 		return -EOPNOTSUPP;
 
+	if (sk_can_busy_loop(sk))
+		sk_busy_loop(sk, 1); /* only support non-blocking sockets */
+
+	/* The busy-polled napi drives zero-copy Tx, copy mode still needs
+	 * the send to be done from here.
+	 */
+	if (xs->zc && xsk_no_wakeup(sk))
+		return 0;
+
 	return __xsk_sendmsg(sk);
 }
 
+static int xsk_recvmsg(struct socket *sock, struct msghdr *m, size_t len,
+		       int flags)
+{
+	bool need_wait = !(flags & MSG_DONTWAIT);
+	struct sock *sk = sock->sk;
+	struct xdp_sock *xs = xdp_sk(sk);
+
+	if (unlikely(!xsk_is_bound(xs)))
+		return -ENXIO;
+	if (unlikely(!(xs->dev->flags & IFF_UP)))
+		return -ENETDOWN;
+	if (unlikely(!xs->rx))
+		return -ENOBUFS;
+	if (unlikely(need_wait))
+		return -EOPNOTSUPP;
+
+	if (sk_can_busy_loop(sk))
+		sk_busy_loop(sk, 1); /* only support non-blocking sockets */
+
+	if (xsk_no_wakeup(sk))
+		return 0;
+
+	if (xs->zc && (xs->umem->need_wakeup & XDP_WAKEUP_RX))
+		return xsk_wakeup(xs, XDP_WAKEUP_RX);
+	return 0;
+}
+
 static __poll_t xsk_poll(struct file *file, struct socket *sock,
 			     struct poll_table_struct *wait)
 {
@@ -453,7 +619,11 @@ static __poll_t xsk_poll(struct file *file, struct socket *sock,
 
 	umem = xs->umem;
 
-	if (umem->need_wakeup) {
+	if (sk_can_busy_loop(sk))
+		sk_busy_loop(sk, 1); /* only support non-blocking sockets */
+
+	/* A busy-polling application drives the zero-copy napi itself. */
+	if (umem->need_wakeup && !(xs->zc && xsk_no_wakeup(sk))) {
 		if (xs->zc)
 			xsk_wakeup(xs, umem->need_wakeup);
 		else
@@ -617,9 +787,13 @@ static int xsk_bind(struct socket *sock, struct sockaddr *addr, int addr_len)
 
 	flags = sxdp->sxdp_flags;
 	if (flags & ~(XDP_SHARED_UMEM | XDP_COPY | XDP_ZEROCOPY |
-		      XDP_USE_NEED_WAKEUP))
+		      XDP_USE_NEED_WAKEUP | XDP_USE_SG))
 		return -EINVAL;
 
+	/* Multi-buffer packets are only handled by the copy mode paths. */
+	if ((flags & XDP_USE_SG) && (flags & XDP_ZEROCOPY))
+		return -EOPNOTSUPP;
+
 	rtnl_lock();
 	mutex_lock(&xs->mutex);
 	if (xs->state != XSK_READY) {
@@ -645,7 +819,7 @@ static int xsk_bind(struct socket *sock, struct sockaddr *addr, int addr_len)
 		struct socket *sock;
 
 		if ((flags & XDP_COPY) || (flags & XDP_ZEROCOPY) ||
-		    (flags & XDP_USE_NEED_WAKEUP)) {
+		    (flags & XDP_USE_NEED_WAKEUP) || (flags & XDP_USE_SG)) {
 			/* Cannot specify flags for shared sockets. */
 			err = -EINVAL;
 			goto out_unlock;
@@ -683,6 +857,8 @@ static int xsk_bind(struct socket *sock, struct sockaddr *addr, int addr_len)
 		goto out_unlock;
 	} else {
 		/* This xsk has its own umem. */
+		if (flags & XDP_USE_SG)
+			flags |= XDP_COPY;
 		err = xdp_umem_assign_dev(xs->umem, dev, qid, flags);
 		if (err)
 			goto out_unlock;
@@ -690,6 +866,7 @@ static int xsk_bind(struct socket *sock, struct sockaddr *addr, int addr_len)
 
 	xs->dev = dev;
 	xs->zc = xs->umem->zc;
+	xs->sg = !!(flags & XDP_USE_SG);
 	xs->queue_id = qid;
 	xdp_add_sk_umem(xs->umem, xs);
 
@@ -1067,7 +1244,7 @@ static const struct proto_ops xsk_proto_ops = {
 	.setsockopt	= xsk_setsockopt,
 	.getsockopt	= xsk_getsockopt,
 	.sendmsg	= xsk_sendmsg,
-	.recvmsg	= sock_no_recvmsg,
+	.recvmsg	= xsk_recvmsg,
 	.mmap		= xsk_mmap,
 	.sendpage	= sock_no_sendpage,
 };
@@ -39,6 +39,7 @@ struct xsk_queue {
 	struct xdp_ring *ring;
 	u64 invalid_descs;
 	u64 queue_empty_descs;
+	bool skip_pkt;
 };
 
 /* The structure of the shared state of the rings are the same as the
@@ -132,7 +133,7 @@ static inline bool xp_aligned_validate_desc(struct xsk_buff_pool *pool,
 	if (chunk >= pool->addrs_cnt)
 		return false;
 
-	if (desc->options)
+	if (desc->options & ~XDP_PKT_CONTD)
 		return false;
 	return true;
 }
@@ -152,7 +153,7 @@ static inline bool xp_unaligned_validate_desc(struct xsk_buff_pool *pool,
 	    xp_desc_crosses_non_contig_pg(pool, addr, desc->len))
 		return false;
 
-	if (desc->options)
+	if (desc->options & ~XDP_PKT_CONTD)
 		return false;
 	return true;
 }
@@ -168,7 +169,9 @@ static inline bool xskq_cons_is_valid_desc(struct xsk_queue *q,
 					   struct xdp_desc *d,
 					   struct xdp_umem *umem)
 {
-	if (!xp_validate_desc(umem->pool, d)) {
+	/* Multi-buffer packets are only supported in copy mode. */
+	if (!xp_validate_desc(umem->pool, d) ||
+	    (umem->zc && (d->options & XDP_PKT_CONTD))) {
 		q->invalid_descs++;
 		return false;
 	}
@@ -184,9 +187,13 @@ static inline bool xskq_cons_read_desc(struct xsk_queue *q,
 		u32 idx = q->cached_cons & q->ring_mask;
 
 		*desc = ring->desc[idx];
-		if (xskq_cons_is_valid_desc(q, desc, umem))
+		if (q->skip_pkt)
+			q->invalid_descs++;
+		else if (xskq_cons_is_valid_desc(q, desc, umem))
 			return true;
 
+		/* Skip the rest of the packet, if it spans more descriptors */
+		q->skip_pkt = desc->options & XDP_PKT_CONTD;
 		q->cached_cons++;
 	}
 
@@ -243,6 +250,60 @@ static inline bool xskq_cons_peek_desc(struct xsk_queue *q,
 	return xskq_cons_read_desc(q, desc, umem);
 }
 
+/* Read the packet that starts at the head of @q into @descs without
+ * consuming it. Returns the number of descriptors of the packet, 0 if
+ * user space has not produced all of them yet, or the negated number of
+ * descriptors to skip if one of them is invalid or the packet is longer
+ * than @max descriptors.
+ */
+static inline int xskq_cons_read_pkt(struct xsk_queue *q,
+				     struct xdp_desc *descs, u32 max,
+				     struct xdp_umem *umem)
+{
+	struct xdp_rxtx_ring *ring = (struct xdp_rxtx_ring *)q->ring;
+	u32 cons = q->cached_cons;
+	int nb = 0;
+
+	if (q->cached_prod - cons < max)
+		__xskq_cons_peek(q);
+
+	while (cons != q->cached_prod) {
+		struct xdp_desc *desc = &descs[nb++];
+
+		*desc = ring->desc[cons++ & q->ring_mask];
+		if (!xp_validate_desc(umem->pool, desc))
+			goto invalid;
+		if (!(desc->options & XDP_PKT_CONTD))
+			return nb;
+		if (nb == max)
+			goto invalid;
+	}
+	return 0;
+
+invalid:
+	/* Skip up to and including the end of the broken packet, once user
+	 * space has produced it.
+	 */
+	if (!(descs[nb - 1].options & XDP_PKT_CONTD))
+		goto skip;
+	while (cons != q->cached_prod) {
+		nb++;
+		if (!(READ_ONCE(ring->desc[cons++ & q->ring_mask].options) &
+		      XDP_PKT_CONTD))
+			goto skip;
+	}
+	return 0;
+
+skip:
+	q->invalid_descs += nb;
+	return -nb;
+}
+
+static inline void xskq_cons_release_n(struct xsk_queue *q, u32 cnt)
+{
+	q->cached_cons += cnt;
+}
+
 static inline void xskq_cons_release(struct xsk_queue *q)
 {
 	/* To improve performance, only update local state here.
@@ -276,14 +337,23 @@ static inline bool xskq_prod_is_full(struct xsk_queue *q)
 	return !free_entries;
 }
 
-static inline int xskq_prod_reserve(struct xsk_queue *q)
+static inline u32 xskq_prod_nb_free(struct xsk_queue *q, u32 max)
 {
-	if (xskq_prod_is_full(q))
-		return -ENOSPC;
+	u32 free_entries = q->nentries - (q->cached_prod - q->cached_cons);
 
-	/* A, matches D */
-	q->cached_prod++;
-	return 0;
+	if (free_entries >= max)
+		return max;
+
+	/* Refresh the local tail pointer */
+	q->cached_cons = READ_ONCE(q->ring->consumer);
+	free_entries = q->nentries - (q->cached_prod - q->cached_cons);
+
+	return free_entries >= max ? max : free_entries;
+}
+
+static inline void xskq_prod_cancel_n(struct xsk_queue *q, u32 cnt)
+{
+	q->cached_prod -= cnt;
 }
 
 static inline int xskq_prod_reserve_addr(struct xsk_queue *q, u64 addr)
@@ -299,7 +369,7 @@ static inline int xskq_prod_reserve_addr(struct xsk_queue *q, u64 addr)
 }
 
 static inline int xskq_prod_reserve_desc(struct xsk_queue *q,
-					 u64 addr, u32 len)
+					 u64 addr, u32 len, u32 options)
 {
 	struct xdp_rxtx_ring *ring = (struct xdp_rxtx_ring *)q->ring;
 	u32 idx;
@@ -311,6 +381,7 @@ static inline int xskq_prod_reserve_desc(struct xsk_queue *q,
 	idx = q->cached_prod++ & q->ring_mask;
 	ring->desc[idx].addr = addr;
 	ring->desc[idx].len = len;
+	ring->desc[idx].options = options;
 
 	return 0;
 }
@@ -327,16 +398,6 @@ static inline void xskq_prod_submit(struct xsk_queue *q)
 	__xskq_prod_submit(q, q->cached_prod);
 }
 
-static inline void xskq_prod_submit_addr(struct xsk_queue *q, u64 addr)
-{
-	struct xdp_umem_ring *ring = (struct xdp_umem_ring *)q->ring;
-	u32 idx = q->ring->producer;
-
-	ring->desc[idx++ & q->ring_mask] = addr;
-
-	__xskq_prod_submit(q, idx);
-}
-
 static inline void xskq_prod_submit_n(struct xsk_queue *q, u32 nb_entries)
 {
 	__xskq_prod_submit(q, q->ring->producer + nb_entries);
@@ -0,0 +1,129 @@
+// SPDX-License-Identifier: GPL-2.0
+/*
+ * Aggregate lock contention by lock address and call stack using the
+ * lock:contention_begin and lock:contention_end tracepoints.
+ */
+#include <uapi/linux/bpf.h>
+#include <uapi/linux/perf_event.h>
+#include <linux/version.h>
+#include <linux/ptrace.h>
+#include <bpf/bpf_helpers.h>
+
+#define MAX_ENTRIES	10240
+
+struct tstamp_data {
+	u64 timestamp;
+	u64 lock;
+	u32 flags;
+	s32 stack_id;
+};
+
+struct contention_key {
+	u64 lock;
+	s32 stack_id;
+	u32 flags;
+};
+
+struct contention_data {
+	u64 total_time;
+	u64 max_time;
+	u64 count;
+};
+
+/* maps: stacks, tstamp, lock_stat */
+struct bpf_map_def SEC("maps") stacks = {
+	.type = BPF_MAP_TYPE_STACK_TRACE,
+	.key_size = sizeof(u32),
+	.value_size = PERF_MAX_STACK_DEPTH * sizeof(u64),
+	.max_entries = MAX_ENTRIES,
+};
+
+struct bpf_map_def SEC("maps") tstamp = {
+	.type = BPF_MAP_TYPE_HASH,
+	.key_size = sizeof(u32),
+	.value_size = sizeof(struct tstamp_data),
+	.max_entries = MAX_ENTRIES,
+};
+
+struct bpf_map_def SEC("maps") lock_stat = {
+	.type = BPF_MAP_TYPE_HASH,
+	.key_size = sizeof(struct contention_key),
+	.value_size = sizeof(struct contention_data),
+	.max_entries = MAX_ENTRIES,
+};
+
+/* taken from /sys/kernel/debug/tracing/events/lock/contention_begin/format */
+struct contention_begin_args {
+	unsigned long long pad;
+	void *lock_addr;
+	unsigned int flags;
+};
+
+/* taken from /sys/kernel/debug/tracing/events/lock/contention_end/format */
+struct contention_end_args {
+	unsigned long long pad;
+	void *lock_addr;
+	int ret;
+};
+
+SEC("tracepoint/lock/contention_begin")
+int contention_begin(struct contention_begin_args *ctx)
+{
+	u32 pid = bpf_get_current_pid_tgid();
+	struct tstamp_data *pelem, elem;
+
+	/* Nested contention (e.g. a spinlock taken while waiting for a
+	 * mutex) is accounted to the outermost lock only.
+	 */
+	pelem = bpf_map_lookup_elem(&tstamp, &pid);
+	if (pelem && pelem->lock)
+		return 0;
+
+	elem.timestamp = bpf_ktime_get_ns();
+	elem.lock = (u64)(unsigned long)ctx->lock_addr;
+	elem.flags = ctx->flags;
+	elem.stack_id = bpf_get_stackid(ctx, &stacks, BPF_F_FAST_STACK_CMP);
+
+	bpf_map_update_elem(&tstamp, &pid, &elem, BPF_ANY);
+	return 0;
+}
+
+SEC("tracepoint/lock/contention_end")
+int contention_end(struct contention_end_args *ctx)
+{
+	u32 pid = bpf_get_current_pid_tgid();
+	struct contention_data *data, first;
+	struct contention_key key;
+	struct tstamp_data *pelem;
+	u64 duration;
+
+	pelem = bpf_map_lookup_elem(&tstamp, &pid);
+	if (!pelem || pelem->lock != (u64)(unsigned long)ctx->lock_addr)
+		return 0;
+
+	duration = bpf_ktime_get_ns() - pelem->timestamp;
+
+	key.lock = pelem->lock;
+	key.stack_id = pelem->stack_id;
+	key.flags = pelem->flags;
+	bpf_map_delete_elem(&tstamp, &pid);
+
+	data = bpf_map_lookup_elem(&lock_stat, &key);
+	if (!data) {
+		first.total_time = duration;
+		first.max_time = duration;
+		first.count = 1;
+		bpf_map_update_elem(&lock_stat, &key, &first, BPF_NOEXIST);
+		return 0;
+	}
+
+	__sync_fetch_and_add(&data->total_time, duration);
+	__sync_fetch_and_add(&data->count, 1);
+	/* racy, but only used for reporting */
+	if (data->max_time < duration)
+		data->max_time = duration;
+	return 0;
+}
+
+char _license[] SEC("license") = "GPL";
+u32 _version SEC("version") = LINUX_VERSION_CODE;
@@ -0,0 +1,202 @@
+// SPDX-License-Identifier: GPL-2.0
+/*
+ * Per-lock contention profile built from the lock:contention_begin/end
+ * tracepoints. Usage: lockcontention [seconds] [-s]
+ *
+ * Prints the contended locks sorted by total wait time along with the
+ * first non-locking caller; with -s the full kernel stack is printed too.
+ */
+#include <stdio.h>
+#include <unistd.h>
+#include <stdlib.h>
+#include <signal.h>
+#include <string.h>
+#include <errno.h>
+#include <stdbool.h>
+#include <linux/bpf.h>
+#include <linux/perf_event.h>
+#include <sys/resource.h>
+#include <bpf/libbpf.h>
+#include "bpf_load.h"
+#include "trace_helpers.h"
+
+#define MAX_LOCKS	10240
+
+/* flags for lock:contention_begin, see include/trace/events/lock.h */
+#define LCB_F_SPIN	(1U << 0)
+#define LCB_F_READ	(1U << 1)
+#define LCB_F_WRITE	(1U << 2)
+#define LCB_F_RT	(1U << 3)
+#define LCB_F_PERCPU	(1U << 4)
+#define LCB_F_MUTEX	(1U << 5)
+
+struct contention_key {
+	__u64 lock;
+	__s32 stack_id;
+	__u32 flags;
+};
+
+struct contention_data {
+	__u64 total_time;
+	__u64 max_time;
+	__u64 count;
+};
+
+struct lock_entry {
+	struct contention_key key;
+	struct contention_data data;
+};
+
+static struct lock_entry entries[MAX_LOCKS];
+static bool show_stacks;
+
+static const char *lock_type(__u32 flags)
+{
+	switch (flags & ~LCB_F_SPIN) {
+	case 0:
+		return "spinlock";
+	case LCB_F_READ:
+		return (flags & LCB_F_SPIN) ? "rwlock:R" : "rwsem:R";
+	case LCB_F_WRITE:
+		return (flags & LCB_F_SPIN) ? "rwlock:W" : "rwsem:W";
+	case LCB_F_RT:
+		return "rtmutex";
+	case LCB_F_PERCPU | LCB_F_READ:
+		return "pcpu-sem:R";
+	case LCB_F_PERCPU | LCB_F_WRITE:
+		return "pcpu-sem:W";
+	case LCB_F_MUTEX:
+		return "mutex";
+	}
+	return "unknown";
+}
+
+/* Locking functions are skipped to find the caller of the lock operation */
+static bool is_lock_function(const char *name)
+{
+	static const char * const prefixes[] = {
+		"_raw_", "queued_", "__mutex_", "mutex_", "rwsem_", "down_",
+		"__down_", "percpu_down_", "__percpu_down_", "rt_mutex_",
+		"__rt_mutex_", "do_raw_", "__lock_", "lock_",
+	};
+	unsigned int i;
+
+	for (i = 0; i < sizeof(prefixes) / sizeof(prefixes[0]); i++)
+		if (!strncmp(name, prefixes[i], strlen(prefixes[i])))
+			return true;
+	return false;
+}
+
+static void print_stack(struct contention_key *key)
+{
+	__u64 ip[PERF_MAX_STACK_DEPTH] = {};
+	const char *caller = "[unknown]";
+	struct ksym *sym;
+	int i;
+
+	if (key->stack_id < 0 ||
+	    bpf_map_lookup_elem(map_fd[0], &key->stack_id, ip) != 0) {
+		printf("  %s\n", caller);
+		return;
+	}
+
+	for (i = 0; i < PERF_MAX_STACK_DEPTH && ip[i]; i++) {
+		sym = ksym_search(ip[i]);
+		if (sym && !is_lock_function(sym->name)) {
+			caller = sym->name;
+			break;
+		}
+	}
+	printf("  %s\n", caller);
+
+	if (!show_stacks)
+		return;
+
+	for (i = 0; i < PERF_MAX_STACK_DEPTH && ip[i]; i++) {
+		sym = ksym_search(ip[i]);
+		printf("\t\t\t\t\t\t\t%#llx %s\n", ip[i],
+		       sym ? sym->name : "[unknown]");
+	}
+}
+
+static int cmp_total(const void *a, const void *b)
+{
+	const struct lock_entry *ea = a, *eb = b;
+
+	if (ea->data.total_time == eb->data.total_time)
+		return 0;
+	return ea->data.total_time < eb->data.total_time ? 1 : -1;
+}
+
+static void print_contention(void)
+{
+	struct contention_key key = {}, next_key;
+	int i, nr = 0;
+
+	while (nr < MAX_LOCKS &&
+	       bpf_map_get_next_key(map_fd[2], &key, &next_key) == 0) {
+		if (bpf_map_lookup_elem(map_fd[2], &next_key,
+					&entries[nr].data) == 0) {
+			entries[nr].key = next_key;
+			nr++;
+		}
+		key = next_key;
+	}
+
+	qsort(entries, nr, sizeof(entries[0]), cmp_total);
+
+	printf("%10s %12s %12s %12s %12s %18s  %s\n", "contended",
+	       "total wait", "max wait", "avg wait", "type", "lock", "caller");
+	for (i = 0; i < nr; i++) {
+		struct lock_entry *e = &entries[i];
+
+		printf("%10llu %10llu us %10llu us %10llu ns %12s %#18llx",
+		       e->data.count, e->data.total_time / 1000,
+		       e->data.max_time / 1000,
+		       e->data.total_time / e->data.count,
+		       lock_type(e->key.flags), e->key.lock);
+		print_stack(&e->key);
+	}
+}
+
+static void int_exit(int sig)
+{
+	print_contention();
+	exit(0);
+}
+
+int main(int argc, char **argv)
+{
+	struct rlimit r = {RLIM_INFINITY, RLIM_INFINITY};
+	char filename[256];
+	int delay = 5;
+	int i;
+
+	for (i = 1; i < argc; i++) {
+		if (!strcmp(argv[i], "-s"))
+			show_stacks = true;
+		else
+			delay = atoi(argv[i]);
+	}
+
+	snprintf(filename, sizeof(filename), "%s_kern.o", argv[0]);
+	setrlimit(RLIMIT_MEMLOCK, &r);
+
+	signal(SIGINT, int_exit);
+	signal(SIGTERM, int_exit);
+
+	if (load_kallsyms()) {
+		printf("failed to process /proc/kallsyms\n");
+		return 2;
+	}
+
+	if (load_bpf_file(filename)) {
+		printf("%s", bpf_log_buf);
+		return 1;
+	}
+
+	sleep(delay);
+	print_contention();
+
+	return 0;
+}
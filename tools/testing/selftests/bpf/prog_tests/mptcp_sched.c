@@ -0,0 +1,182 @@
+// SPDX-License-Identifier: GPL-2.0
+
+#define _GNU_SOURCE
+#include <sched.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <test_progs.h>
+#include "mptcp_bpf_first.skel.h"
+
+#ifndef IPPROTO_MPTCP
+#define IPPROTO_MPTCP		262
+#endif
+#ifndef SOL_MPTCP
+#define SOL_MPTCP		284
+#endif
+#ifndef MPTCP_SCHEDULER
+#define MPTCP_SCHEDULER		1
+#endif
+
+#define SCHED_NAME		"bpf_first"
+#define SYSCTL_SCHED		"/proc/sys/net/mptcp/scheduler"
+
+static __u32 duration;
+
+static int write_sysctl(const char *path, const char *val)
+{
+	int fd, len = strlen(val);
+
+	fd = open(path, O_WRONLY);
+	if (fd < 0)
+		return -errno;
+	if (write(fd, val, len) != len) {
+		close(fd);
+		return -errno;
+	}
+	close(fd);
+	return 0;
+}
+
+static int start_mptcp_server(struct sockaddr_in *addr)
+{
+	socklen_t len = sizeof(*addr);
+	int fd;
+
+	fd = socket(AF_INET, SOCK_STREAM, IPPROTO_MPTCP);
+	if (fd < 0)
+		return -errno;
+
+	addr->sin_family = AF_INET;
+	addr->sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+	addr->sin_port = 0;
+	if (bind(fd, (struct sockaddr *)addr, len) ||
+	    getsockname(fd, (struct sockaddr *)addr, &len) ||
+	    listen(fd, 1)) {
+		close(fd);
+		return -errno;
+	}
+
+	return fd;
+}
+
+/* Connect to the server, select the scheduler if asked to, and check that
+ * data goes through and that the selected scheduler is the one in use.
+ */
+static void run_transfer(struct mptcp_bpf_first *skel, bool setsockopt_sched)
+{
+	char buf[4096] = {}, name[16] = {};
+	socklen_t len = sizeof(name);
+	int srv_fd, cli_fd, fd, err;
+	struct sockaddr_in addr;
+	ssize_t n, total = 0;
+
+	srv_fd = start_mptcp_server(&addr);
+	if (CHECK(srv_fd < 0, "start_mptcp_server", "err %d\n", srv_fd))
+		return;
+
+	cli_fd = socket(AF_INET, SOCK_STREAM, IPPROTO_MPTCP);
+	if (CHECK(cli_fd < 0, "socket", "errno %d\n", errno))
+		goto close_srv;
+
+	if (setsockopt_sched) {
+		err = setsockopt(cli_fd, SOL_MPTCP, MPTCP_SCHEDULER, SCHED_NAME,
+				 strlen(SCHED_NAME));
+		if (CHECK(err, "setsockopt MPTCP_SCHEDULER", "errno %d\n",
+			  errno))
+			goto close_cli;
+	}
+
+	err = getsockopt(cli_fd, SOL_MPTCP, MPTCP_SCHEDULER, name, &len);
+	if (CHECK(err || strcmp(name, SCHED_NAME), "getsockopt MPTCP_SCHEDULER",
+		  "err %d name %s\n", err, name))
+		goto close_cli;
+
+	skel->bss->nr_get_subflow = 0;
+
+	err = connect(cli_fd, (struct sockaddr *)&addr, sizeof(addr));
+	if (CHECK(err, "connect", "errno %d\n", errno))
+		goto close_cli;
+
+	fd = accept(srv_fd, NULL, NULL);
+	if (CHECK(fd < 0, "accept", "errno %d\n", errno))
+		goto close_cli;
+
+	n = send(cli_fd, buf, sizeof(buf), 0);
+	if (CHECK(n != sizeof(buf), "send", "sent %zd errno %d\n", n, errno))
+		goto close_fd;
+
+	while (total < sizeof(buf)) {
+		n = recv(fd, buf, sizeof(buf) - total, 0);
+		if (n <= 0)
+			break;
+		total += n;
+	}
+	CHECK(total != sizeof(buf), "recv", "received %zd\n", total);
+	CHECK(!skel->bss->nr_get_subflow, "nr_get_subflow",
+	      "scheduler not called\n");
+
+close_fd:
+	close(fd);
+close_cli:
+	close(cli_fd);
+close_srv:
+	close(srv_fd);
+}
+
+void test_mptcp_sched(void)
+{
+	struct mptcp_bpf_first *skel;
+	int netns_fd, fd, err;
+	struct bpf_link *link;
+
+	fd = socket(AF_INET, SOCK_STREAM, IPPROTO_MPTCP);
+	if (fd < 0) {
+		test__skip();
+		return;
+	}
+	close(fd);
+
+	skel = mptcp_bpf_first__open_and_load();
+	if (CHECK(!skel, "mptcp_bpf_first__open_and_load", "failed\n"))
+		return;
+
+	link = bpf_map__attach_struct_ops(skel->maps.first);
+	if (CHECK(IS_ERR(link), "bpf_map__attach_struct_ops", "err %ld\n",
+		  PTR_ERR(link)))
+		goto destroy;
+
+	/* Per socket selection, in the current netns */
+	run_transfer(skel, true);
+	CHECK(!skel->bss->nr_init, "nr_init", "init not called\n");
+
+	/* Per netns selection, in a new netns not to affect other tests */
+	netns_fd = open("/proc/self/ns/net", O_RDONLY);
+	if (CHECK(netns_fd < 0, "open netns", "errno %d\n", errno))
+		goto detach;
+
+	err = unshare(CLONE_NEWNET);
+	if (CHECK(err, "unshare", "errno %d\n", errno))
+		goto close_netns;
+
+	if (CHECK(system("ip link set dev lo up"), "ip link set lo up",
+		  "failed\n"))
+		goto restore_netns;
+
+	err = write_sysctl(SYSCTL_SCHED, SCHED_NAME);
+	if (CHECK(err, "write " SYSCTL_SCHED, "err %d\n", err))
+		goto restore_netns;
+
+	run_transfer(skel, false);
+
+restore_netns:
+	CHECK(setns(netns_fd, CLONE_NEWNET), "setns", "errno %d\n", errno);
+close_netns:
+	close(netns_fd);
+detach:
+	bpf_link__destroy(link);
+destroy:
+	mptcp_bpf_first__destroy(skel);
+}
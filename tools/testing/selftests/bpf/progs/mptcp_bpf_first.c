@@ -0,0 +1,39 @@
+// SPDX-License-Identifier: GPL-2.0
+
+/* MPTCP packet scheduler always picking the first subflow */
+
+#include "vmlinux.h"
+#include <bpf/bpf_helpers.h>
+#include <bpf/bpf_tracing.h>
+
+#define ENOENT	2
+
+char _license[] SEC("license") = "GPL";
+
+int nr_init = 0;
+int nr_get_subflow = 0;
+
+SEC("struct_ops/mptcp_sched_first_init")
+void BPF_PROG(mptcp_sched_first_init, struct mptcp_sock *msk)
+{
+	nr_init++;
+}
+
+SEC("struct_ops/bpf_first_get_subflow")
+int BPF_PROG(bpf_first_get_subflow, struct mptcp_sock *msk,
+	     struct mptcp_sched_data *data)
+{
+	nr_get_subflow++;
+	if (!data->nr_subflows)
+		return -ENOENT;
+
+	data->scheduled = 1;
+	return 0;
+}
+
+SEC(".struct_ops")
+struct mptcp_sched_ops first = {
+	.init		= (void *)mptcp_sched_first_init,
+	.get_subflow	= (void *)bpf_first_get_subflow,
+	.name		= "bpf_first",
+};
@@ -204,7 +204,7 @@ make_file()
 	name=$1
 	who=$2
 
-	SIZE=1
+	SIZE=${3:-1}
 
 	dd if=/dev/urandom of="$name" bs=1024 count=$SIZE 2> /dev/null
 	echo -e "\nMPTCP_TEST_FILE_END_MARKER" >> "$name"
@@ -276,6 +276,30 @@ chk_join_nr()
 	fi
 }
 
+# Check that each of the first $1 links carried at least $2 bytes in both
+# directions, that is, that every subflow was used to send data.
+chk_subflow_data()
+{
+	local links=$1
+	local min_bytes=$2
+	local count
+	local i
+
+	printf "%-39s %s" " " "data"
+	for i in `seq 1 $links`; do
+		for netns in "$ns1" "$ns2"; do
+			count=`ip netns exec $netns cat /sys/class/net/ns${netns%%-*}eth$i/statistics/rx_bytes 2>/dev/null`
+			[ -z "$count" ] && count=0
+			if [ "$count" -lt "$min_bytes" ]; then
+				echo "[fail] got $count bytes on link $i in ${netns%%-*}, expected at least $min_bytes"
+				ret=1
+				return
+			fi
+		done
+	done
+	echo "[ ok ]"
+}
+
 sin=$(mktemp)
 sout=$(mktemp)
 cin=$(mktemp)
@@ -327,6 +351,27 @@ ip netns exec $ns2 ./pm_nl_ctl add 10.0.2.2 flags subflow
 run_tests $ns1 $ns2 10.0.1.1
 chk_join_nr "multiple subflows, limited by server" 2 2 1
 
+# multiple subflows, data sent on all of them
+reset
+ip netns exec $ns1 sysctl -q net.mptcp.scheduler=redundant
+ip netns exec $ns2 sysctl -q net.mptcp.scheduler=redundant
+ip netns exec $ns1 ./pm_nl_ctl limits 0 2
+ip netns exec $ns2 ./pm_nl_ctl limits 0 2
+ip netns exec $ns2 ./pm_nl_ctl add 10.0.3.2 flags subflow
+ip netns exec $ns2 ./pm_nl_ctl add 10.0.2.2 flags subflow
+# slow the links down so that most of the data is sent after the joins
+for i in 1 2 3; do
+	tc -n $ns1 qdisc add dev ns1eth$i root netem rate 20mbit
+	tc -n $ns2 qdisc add dev ns2eth$i root netem rate 20mbit
+done
+make_file "$cin" "client" 512
+make_file "$sin" "server" 512
+run_tests $ns1 $ns2 10.0.1.1
+chk_join_nr "multiple subflows, redundant scheduler" 2 2 2
+chk_subflow_data 3 $((512 * 1024 / 2))
+make_file "$cin" "client"
+make_file "$sin" "server"
+
 # add_address, unused
 reset
 ip netns exec $ns1 ./pm_nl_ctl add 10.0.2.1 flags signal
@@ -0,0 +1,107 @@
+#!/bin/bash
+# SPDX-License-Identifier: GPL-2.0
+#
+# Measure the lookup rate of the pipapo set implementation picked for this
+# machine (NEON on arm64, AVX2 on x86_64 where available): an
+# "ipv4_addr . inet_service" interval set with ELEMENTS entries is matched by
+# a netdev ingress chain against packets injected by pktgen on a veth pair.
+#
+# Environment: ELEMENTS (default: 10000), DURATION in seconds (default: 5)
+
+# Kselftest framework requirement - SKIP code is 4.
+ksft_skip=4
+
+ELEMENTS=${ELEMENTS:-10000}
+DURATION=${DURATION:-5}
+ns="nft-pipapo-bench-$(mktemp -u XXXXXX)"
+
+cleanup() {
+	ip netns del "${ns}" 2>/dev/null
+}
+
+skip() {
+	echo "SKIP: $*"
+	exit ${ksft_skip}
+}
+
+pg() {
+	ip netns exec "${ns}" sh -c "echo '${2}' > /proc/net/pktgen/${1}"
+}
+
+nft --version > /dev/null 2>&1 || skip "nft not available"
+ip -Version > /dev/null 2>&1 || skip "ip not available"
+modprobe -q nf_tables
+modprobe -q pktgen
+[ -d /proc/net/pktgen ] || skip "pktgen not available"
+
+trap cleanup EXIT
+
+ip netns add "${ns}" || skip "can't create net namespace"
+ip -n "${ns}" link add veth_a type veth peer name veth_b || exit 1
+ip -n "${ns}" link set veth_a up
+ip -n "${ns}" link set veth_b up
+dst_mac="$(ip netns exec "${ns}" cat /sys/class/net/veth_b/address)"
+
+# Elements: 10.64.0.0 . 1000-1009, 10.64.0.1 . 1010-1019, ...
+elements() {
+	local i
+
+	for i in $(seq 0 $((ELEMENTS - 1))); do
+		printf "10.64.%d.%d . %d-%d, " $((i / 256 % 256)) $((i % 256)) \
+			$((1000 + i % 4000 * 10)) $((1009 + i % 4000 * 10))
+	done
+}
+
+load() {
+	ip netns exec "${ns}" nft -f - <<-EOF_NFT
+	flush ruleset
+	table netdev bench {
+		set s {
+			type ipv4_addr . inet_service
+			flags interval
+			elements = { $(elements) }
+		}
+		chain ingress {
+			type filter hook ingress device veth_b priority 0; policy drop;
+			counter
+			ip daddr . udp dport @s counter drop
+		}
+	}
+	EOF_NFT
+}
+
+run() {
+	local total hits
+
+	load || { echo "FAIL: can't load ruleset"; return 1; }
+
+	pg kpktgend_0 "rem_device_all"
+	pg kpktgend_0 "add_device veth_a"
+	pg veth_a "count 0"
+	pg veth_a "pkt_size 64"
+	pg veth_a "dst_mac ${dst_mac}"
+	pg veth_a "dst_min 10.64.0.0"
+	pg veth_a "dst_max 10.64.$(((ELEMENTS - 1) / 256 % 256)).255"
+	pg veth_a "udp_dst_min 1000"
+	pg veth_a "udp_dst_max 40999"
+	pg veth_a "flag IPDST_RND"
+	pg veth_a "flag UDPDST_RND"
+
+	pg pgctrl "start" &
+	sleep "${DURATION}"
+	pg pgctrl "stop"
+	wait
+
+	set -- $(ip netns exec "${ns}" nft list chain netdev bench ingress | \
+		 awk '{ for (i = 1; i < NF; i++) if ($i == "packets") print $(i + 1) }')
+	total="${1}"
+	hits="${2}"
+
+	printf "%12d lookups/s, %3d%% matches\n" \
+	       $((total / DURATION)) $((hits * 100 / (total + 1)))
+
+	[ "${hits}" -gt 0 ] || { echo "FAIL: no matches"; return 1; }
+}
+
+echo "pipapo lookup, ${ELEMENTS} elements, ${DURATION}s:"
+run
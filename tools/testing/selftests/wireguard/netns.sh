@@ -0,0 +1,213 @@
+#!/bin/bash
+# SPDX-License-Identifier: GPL-2.0
+#
+# Copyright (C) 2015-2019 Jason A. Donenfeld <Jason@zx2c4.com>. All Rights Reserved.
+#
+# This script tests the below topology:
+#
+# ┌─────────────────────┐   ┌──────────────────────────────────┐   ┌─────────────────────┐
+# │   $ns1 namespace    │   │          $ns0 namespace          │   │   $ns2 namespace    │
+# │                     │   │                                  │   │                     │
+# │┌────────┐           │   │            ┌────────┐            │   │           ┌────────┐│
+# ││  wg0   │───────────┼───┼────────────│   lo   │────────────┼───┼───────────│  wg0   ││
+# │├────────┴──────────┐│   │    ┌───────┴────────┴────────┐   │   │┌──────────┴────────┤│
+# ││192.168.241.1/24   ││   │    │(ns1)         (ns2)      │   │   ││192.168.241.2/24   ││
+# ││fd00::1/112        ││   │    │127.0.0.1:1   127.0.0.1:2│   │   ││fd00::2/112        ││
+# │└───────────────────┘│   │    │[::]:1        [::]:2     │   │   │└───────────────────┘│
+# │                     │   │    └─────────────────────────┘   │   │                     │
+# │┌────────┐           │   │  ┌────────┐          ┌────────┐  │   │           ┌────────┐│
+# ││  wg1   │───veth1───┼───┼──│ veth1  │  router  │ veth2  │──┼───┼───veth2───│  wg1   ││
+# │└────────┘           │   │  └────────┘          └────────┘  │   │           └────────┘│
+# └─────────────────────┘   └──────────────────────────────────┘   └─────────────────────┘
+#
+# The wg0 devices are created in $ns0 and moved, so their sockets use its
+# loopback device. Bulk TCP through them is sent as UDP GSO trains by the
+# sender and received as GRO'd trains on the other side. The wg1 devices
+# keep their sockets in $ns1 and $ns2 and reach each other through $ns0,
+# which routes IPv6 onto a link with a smaller MTU than the trains' segments.
+
+set -e
+
+exec 3>&1
+export LANG=C
+export WG_HIDE_KEYS=never
+netns0="wg-test-$$-0"
+netns1="wg-test-$$-1"
+netns2="wg-test-$$-2"
+pretty() { echo -e "\x1b[32m\x1b[1m[+] ${1:+NS$1: }${2}\x1b[0m" >&3; }
+pp() { pretty "" "$*"; "$@"; }
+maybe_exec() { if [[ $BASHPID -eq $$ ]]; then "$@"; else exec "$@"; fi; }
+n0() { pretty 0 "$*"; maybe_exec ip netns exec $netns0 "$@"; }
+n1() { pretty 1 "$*"; maybe_exec ip netns exec $netns1 "$@"; }
+n2() { pretty 2 "$*"; maybe_exec ip netns exec $netns2 "$@"; }
+ip0() { pretty 0 "ip $*"; ip -n $netns0 "$@"; }
+ip1() { pretty 1 "ip $*"; ip -n $netns1 "$@"; }
+ip2() { pretty 2 "ip $*"; ip -n $netns2 "$@"; }
+sleep() { read -t "$1" -N 1 || true; }
+waitiperf() { pretty "${1//*-}" "wait for iperf:${3:-5201} pid $2"; while [[ $(ss -N "$1" -tlpH "sport = ${3:-5201}") != *\"iperf3\",pid=$2,fd=* ]]; do sleep 0.1; done; }
+waitiface() { pretty "${1//*-}" "wait for $2 to come up"; ip netns exec "$1" bash -c "while [[ \$(< \"/sys/class/net/$2/operstate\") != up ]]; do read -t .1 -N 0 || true; done;"; }
+
+cleanup() {
+	set +e
+	exec 2>/dev/null
+	printf "$orig_message_cost" > /proc/sys/net/core/message_cost
+	ip1 link del dev wg0
+	ip1 link del dev wg1
+	ip2 link del dev wg0
+	ip2 link del dev wg1
+	local to_kill="$(ip netns pids $netns0) $(ip netns pids $netns1) $(ip netns pids $netns2)"
+	[[ -n $to_kill ]] && kill $to_kill
+	pp ip netns del $netns1
+	pp ip netns del $netns2
+	pp ip netns del $netns0
+	exit
+}
+
+orig_message_cost="$(< /proc/sys/net/core/message_cost)"
+trap cleanup EXIT
+printf 0 > /proc/sys/net/core/message_cost
+
+ip netns del $netns0 2>/dev/null || true
+ip netns del $netns1 2>/dev/null || true
+ip netns del $netns2 2>/dev/null || true
+pp ip netns add $netns0
+pp ip netns add $netns1
+pp ip netns add $netns2
+ip0 link set up dev lo
+ip1 link set up dev lo
+ip2 link set up dev lo
+
+ip0 link add dev wg0 type wireguard
+ip0 link set wg0 netns $netns1
+ip0 link add dev wg0 type wireguard
+ip0 link set wg0 netns $netns2
+key1="$(pp wg genkey)"
+key2="$(pp wg genkey)"
+pub1="$(pp wg pubkey <<<"$key1")"
+pub2="$(pp wg pubkey <<<"$key2")"
+
+ip1 addr add 192.168.241.1/24 dev wg0
+ip1 addr add fd00::1/112 dev wg0
+ip2 addr add 192.168.241.2/24 dev wg0
+ip2 addr add fd00::2/112 dev wg0
+
+n1 wg set wg0 \
+	private-key <(echo "$key1") \
+	listen-port 1 \
+	peer "$pub2" \
+		allowed-ips 192.168.241.2/32,fd00::2/128
+n2 wg set wg0 \
+	private-key <(echo "$key2") \
+	listen-port 2 \
+	peer "$pub1" \
+		allowed-ips 192.168.241.1/32,fd00::1/128
+ip1 link set up dev wg0
+ip2 link set up dev wg0
+
+tests() {
+	# Ping over IPv4
+	n2 ping -c 10 -f -W 1 192.168.241.1
+	n1 ping -c 10 -f -W 1 192.168.241.2
+
+	# Ping over IPv6
+	n2 ping6 -c 10 -f -W 1 fd00::1
+	n1 ping6 -c 10 -f -W 1 fd00::2
+
+	# TCP over IPv4, bulk data goes out as UDP GSO trains
+	n2 iperf3 -s -1 -B 192.168.241.2 &
+	waitiperf $netns2 $!
+	n1 iperf3 -Z -t 3 -c 192.168.241.2
+
+	# TCP over IPv6
+	n1 iperf3 -s -1 -B fd00::1 &
+	waitiperf $netns1 $!
+	n2 iperf3 -Z -t 3 -c fd00::1
+
+	# UDP over IPv4
+	n1 iperf3 -s -1 -B 192.168.241.1 &
+	waitiperf $netns1 $!
+	n2 iperf3 -Z -t 3 -b 0 -u -c 192.168.241.1
+
+	# UDP over IPv6
+	n2 iperf3 -s -1 -B fd00::2 &
+	waitiperf $netns2 $!
+	n1 iperf3 -Z -t 3 -b 0 -u -c fd00::2
+}
+
+[[ $(ip1 link show dev wg0) =~ mtu\ ([0-9]+) ]] && orig_mtu="${BASH_REMATCH[1]}"
+big_mtu=$(( 34816 - 1500 + $orig_mtu ))
+
+# Test using IPv4 as outer transport
+n1 wg set wg0 peer "$pub2" endpoint 127.0.0.1:2
+n2 wg set wg0 peer "$pub1" endpoint 127.0.0.1:1
+tests
+ip1 link set wg0 mtu $big_mtu
+ip2 link set wg0 mtu $big_mtu
+tests
+
+ip1 link set wg0 mtu $orig_mtu
+ip2 link set wg0 mtu $orig_mtu
+
+# Test using IPv6 as outer transport
+n1 wg set wg0 peer "$pub2" endpoint [::1]:2
+n2 wg set wg0 peer "$pub1" endpoint [::1]:1
+tests
+ip1 link set wg0 mtu $big_mtu
+ip2 link set wg0 mtu $big_mtu
+tests
+
+ip1 link set wg0 mtu $orig_mtu
+ip2 link set wg0 mtu $orig_mtu
+
+# Test trains over a routed IPv6 path with a smaller MTU than their
+# segments. IPv6 doesn't fragment GSO packets, so a full sized train would
+# be dropped by the router; wg has to send them as fragmented packets.
+ip0 link add veth1 type veth peer name veth1 netns $netns1
+ip0 link add veth2 type veth peer name veth2 netns $netns2
+n0 bash -c 'printf 1 > /proc/sys/net/ipv6/conf/all/forwarding'
+ip0 addr add fd00:aa::2/96 dev veth1 nodad
+ip0 addr add fd00:bb::2/96 dev veth2 nodad
+ip1 addr add fd00:aa::1/96 dev veth1 nodad
+ip2 addr add fd00:bb::1/96 dev veth2 nodad
+ip0 link set veth1 up
+ip0 link set veth2 mtu 1280 up
+ip1 link set veth1 up
+ip2 link set veth2 mtu 1280 up
+ip1 route add default via fd00:aa::2
+ip2 route add default via fd00:bb::2
+
+ip1 link add dev wg1 type wireguard
+ip2 link add dev wg1 type wireguard
+ip1 addr add 192.168.242.1/24 dev wg1
+ip2 addr add 192.168.242.2/24 dev wg1
+n1 wg set wg1 \
+	private-key <(echo "$key1") \
+	listen-port 3 \
+	peer "$pub2" \
+		allowed-ips 192.168.242.2/32 \
+		endpoint [fd00:bb::1]:4
+n2 wg set wg1 \
+	private-key <(echo "$key2") \
+	listen-port 4 \
+	peer "$pub1" \
+		allowed-ips 192.168.242.1/32 \
+		endpoint [fd00:aa::1]:3
+ip1 link set wg1 mtu $orig_mtu up
+ip2 link set wg1 mtu $orig_mtu up
+waitiface $netns1 veth1
+waitiface $netns2 veth2
+
+n1 ping -c 10 -f -W 1 192.168.242.2
+n2 iperf3 -s -1 -B 192.168.242.2 &
+waitiperf $netns2 $!
+n1 iperf3 -Z -t 3 -c 192.168.242.2
+n1 iperf3 -s -1 -B 192.168.242.1 &
+waitiperf $netns1 $!
+n2 iperf3 -Z -t 3 -c 192.168.242.1
+
+ip1 link del dev wg1
+ip2 link del dev wg1
+ip0 link del veth1
+ip0 link del veth2
+
+echo "Tests passed."